@@ -12,5 +12,6 @@ cp lib/*.so.* /usr/local/lib
 ln -sf /usr/local/lib/libSelene.so.2 /usr/local/lib/libSelene.so
 cp lib/Selene/*.so /usr/local/lib/Selene
 cp Selene /usr/local/bin
+[ -x Selene.bundle ] && cp Selene.bundle /usr/local/bin
 
 echo "please run ldconfig as root"
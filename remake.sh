@@ -33,6 +33,11 @@
 # create false report with Detach() function
 # MCHECK=1
 
+# STATIC_BUNDLE - build as well Selene.bundle : an executable where core modules
+# (listed in src/libSelene/bundle.h) are prelinked instead of being loaded
+# one by one at startup. Other plug-ins are still loaded from PLUGIN_DIR.
+# STATIC_BUNDLE=1
+
 # end of customisation area
 
 # build configuration
@@ -76,6 +81,9 @@ echo "clean:" >> Makefile
 echo -e "\t-rm -f lib/Selene/*.so" >> Makefile
 echo -e "\t-rm -f lib/*.so.2" >> Makefile
 echo -e "\t-rm -f src/*/*.o" >> Makefile
+if [ ${STATIC_BUNDLE+x} ]; then
+	echo -e "\t-rm -rf src/Selene/bundle Selene.bundle" >> Makefile
+fi
 
 echo >> Makefile
 echo "# Build everything" >> Makefile
@@ -513,6 +521,53 @@ LFMakeMaker -g -v -I../include/ +f=Makefile --opts="-I../include $CFLAGS $DEBUG
 cd ../..
 echo -e '\t$(MAKE) -C src/Selene' >> Makefile
 
+echo
+echo "Selene bundle"
+echo "============="
+echo
+
+if [ ${STATIC_BUNDLE+x} ]; then
+	echo "Core modules prelinked in Selene.bundle"
+
+	BUNDLE_OPTS="-I../include $CFLAGS $DEBUG $MCHECK $LUA $USE_PLUGDIR"
+	BUNDLE_OBJS=""
+
+	cd src/Selene
+	echo "# Selene with core modules prelinked (generated by remake.sh)" > Makefile.bundle
+	echo >> Makefile.bundle
+	echo "gotoall: ../../Selene.bundle" >> Makefile.bundle
+	echo >> Makefile.bundle
+
+		# Each module's InitModule() is renamed as per libSelene's bundle table
+	for m in $( sed -n 's/^BUNDLE(\(.*\))$/\1/p' ../libSelene/bundle.h ); do
+		for f in ../$m/*.c; do
+			o=bundle/$m-$( basename $f .c ).o
+			BUNDLE_OBJS="$BUNDLE_OBJS $o"
+			echo "$o: $f \$(wildcard ../$m/*.h ../include/Selene/*.h)" >> Makefile.bundle
+			echo -e "\t@mkdir -p bundle" >> Makefile.bundle
+			echo -e "\t\$(CC) -c $BUNDLE_OPTS -DInitModule=${m}_InitModule -o \$@ \$<" >> Makefile.bundle
+			echo >> Makefile.bundle
+		done
+	done
+
+	for f in ../libSelene/*.c *.c; do
+		o=bundle/$( basename $f .c ).o
+		BUNDLE_OBJS="$BUNDLE_OBJS $o"
+		echo "$o: $f \$(wildcard ../libSelene/*.h ../include/Selene/*.h)" >> Makefile.bundle
+		echo -e "\t@mkdir -p bundle" >> Makefile.bundle
+		echo -e "\t\$(CC) -c $BUNDLE_OPTS -DSTATIC_BUNDLE -o \$@ \$<" >> Makefile.bundle
+		echo >> Makefile.bundle
+	done
+
+	echo "../../Selene.bundle:$BUNDLE_OBJS" >> Makefile.bundle
+	echo -e "\t\$(CC) -o \$@ $BUNDLE_OBJS $LUALIB $MCHECK_LIB -lpaho-mqtt3c -lm -ldl -Wl,--export-dynamic -lpthread" >> Makefile.bundle
+	cd ../..
+
+	echo -e '\t$(MAKE) -C src/Selene -f Makefile.bundle' >> Makefile
+else
+	echo "Selene bundle not built"
+fi
+
 echo
 echo "C examples"
 echo "=========="
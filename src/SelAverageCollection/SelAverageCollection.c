@@ -19,6 +19,7 @@ and a long term trend to avoid too large curve.
 * 11/06/2022 LF : creation
 * 27/03/2024 LF : migrate to v7
 * 07/04/2024 LF : Switch to named collection
+* 18/10/2026 Collections are released when unused
 
 @usage
 local col = SelAverageCollection.Create("my collection",5,7,3)
@@ -146,20 +147,39 @@ static struct SelAverageCollectionStorage *sacc_find(const char *name, unsigned
 
 }
 
-static int sacl_find(lua_State *L){
-	struct SelAverageCollectionStorage *col = selAverageCollection.find(luaL_checkstring(L, 1), 0);
-	if(!col)
-		return 0;
-
+static void sacl_pushcollection(lua_State *L, struct SelAverageCollectionStorage *col){
+/* Push a Lua object for a collection we hold a reference on
+ * (released by __gc)
+ */
 	struct SelAverageCollectionStorage **r = lua_newuserdata(L, sizeof(struct SelAverageCollectionStorage *));
 	assert(r);
 	luaL_getmetatable(L, "SelAverageCollection");
 	lua_setmetatable(L, -2);
 	*r = col;
+}
+
+static int sacl_find(lua_State *L){
+	struct SelAverageCollectionStorage *col = (struct SelAverageCollectionStorage *)selCore->retainNamedObject((struct SelModule *)&selAverageCollection, luaL_checkstring(L, 1), 0);
+	if(!col)
+		return 0;
 
+	sacl_pushcollection(L, col);
 	return 1;
 }
 
+static void sacc_free(struct SelAverageCollectionStorage *col){
+/* Free a collection which is not referenced anymore */
+	pthread_mutex_destroy(&col->mutex);
+	for(size_t i=0; i<col->isize; i++)
+		free(col->immediate[i].data);
+	free(col->immediate);
+	for(size_t i=0; i<col->asize; i++)
+		free(col->average[i].data);
+	free(col->average);
+	free((void *)col->obj.id.name);
+	free(col);
+}
+
 static struct SelAverageCollectionStorage *sacc_create(const char *name, size_t isize, size_t asize, size_t grouping, size_t ndata){
 /** 
  * Create a new SelAverageCollection
@@ -217,10 +237,18 @@ static struct SelAverageCollectionStorage *sacc_create(const char *name, size_t
 	col->afull = false;
 
 		/* Register this collection */
-	if(name)
-		selCore->registerNamedObject((struct SelModule *)&selAverageCollection, (struct _SelNamedObject *)col, strdup(name));
-	else
-		selCore->initObject((struct SelModule *)&selAverageCollection, (struct SelObject *)col);
+	if(name){
+		char *dname = strdup(name);
+		assert(dname);
+		col->obj.id.name = NULL;
+		if(!selCore->registerNamedObject((struct SelModule *)&selAverageCollection, (struct _SelNamedObject *)col, dname)){
+			/* Created meanwhile by another thread : use it */
+			col->obj.id.name = dname;	/* freed with the collection */
+			sacc_free(col);
+			return sacc_find(name, 0);
+		}
+	} else
+		selCore->initNamedObject((struct SelModule *)&selAverageCollection, (struct _SelNamedObject *)col);
 
 	MCHECK;
 	return col;
@@ -241,17 +269,45 @@ static int sacl_create(lua_State *L){
 	if(isize < group)
 		return luaL_error(L, "SelAverageCollection's grouping can't be > to immediate sample size");
 
-	struct SelAverageCollectionStorage **p = (struct SelAverageCollectionStorage **)lua_newuserdata(L, sizeof(struct SelAverageCollectionStorage *));
-	assert(p);
-	*p = sacc_create(name, isize, asize, group, ndata);
+	struct SelAverageCollectionStorage *col;
+	if(name){
+		while(!(col = (struct SelAverageCollectionStorage *)selCore->retainNamedObject((struct SelModule *)&selAverageCollection, name, 0)))
+			sacc_create(name, isize, asize, group, ndata);	/* (Re)create it as it doesn't exist (anymore) */
+	} else {
+		col = sacc_create(NULL, isize, asize, group, ndata);
+		selCore->retainObject((struct SelModule *)&selAverageCollection, (struct _SelNamedObject *)col);
+	}
 
-	luaL_getmetatable(L, "SelAverageCollection");
-	lua_setmetatable(L, -2);
+	sacl_pushcollection(L, col);
 
 	MCHECK;
 	return 1;
 }
 
+static int sacl_release(lua_State *L){
+/**
+ * Remove the collection from the registry : it can't be found anymore
+ * and is freed as soon as the last reference to it is garbage collected.
+ *
+ * @function Release
+ */
+	struct SelAverageCollectionStorage *col = checkSelAverageCollection(L);
+
+	if(selCore->unregisterNamedObject((struct SelModule *)&selAverageCollection, (struct _SelNamedObject *)col))
+		sacc_free(col);
+
+	return 0;
+}
+
+static int sacl_gc(lua_State *L){
+	struct SelAverageCollectionStorage *col = checkSelAverageCollection(L);
+
+	if(selCore->releaseNamedObject((struct SelModule *)&selAverageCollection, (struct _SelNamedObject *)col))
+		sacc_free(col);
+
+	return 0;
+}
+
 static void sacc_postinsert(struct SelAverageCollectionStorage *col){
 /* Common processing to be done after data insertion in 
  * sacc_push() and sacl_push()
@@ -1020,6 +1076,8 @@ static const struct luaL_Reg SelAverageCollectionM [] = {
 	{"Save", sacl_save},
 	{"Load", sacl_load},
 	{"Clear", sacl_clear},
+	{"Release", sacl_release},
+	{"__gc", sacl_gc},
 	{NULL, NULL}
 };
 
@@ -16,6 +16,7 @@ Typical usage : to store single or multivaled numbers
  *	23/09/2020	LF : Multivalue
  *	15/02/2021	LF : emancipate to create shared collection
  *	24/03/2024	LF : migrate to v7
+ *	18/10/2026	Collections are released when unused
  
 @usage
 -- Multi valued Collection example
@@ -112,17 +113,23 @@ static struct SelCollectionStorage *scc_find(const char *name, unsigned int h){
 	return((struct SelCollectionStorage *)selCore->findNamedObject((struct SelModule *)&selCollection, name, h));
 }
 
-static int scl_find(lua_State *L){
-	struct SelCollectionStorage *col = selCollection.find(luaL_checkstring(L, 1), 0);
-	if(!col)
-		return 0;
-
+static void scl_pushcollection(lua_State *L, struct SelCollectionStorage *col){
+/* Push a Lua object for a collection we hold a reference on
+ * (released by __gc)
+ */
 	struct SelCollectionStorage **r = lua_newuserdata(L, sizeof(struct SelCollectionStorage *));
 	assert(r);
 	luaL_getmetatable(L, "SelCollection");
 	lua_setmetatable(L, -2);
 	*r = col;
+}
+
+static int scl_find(lua_State *L){
+	struct SelCollectionStorage *col = (struct SelCollectionStorage *)selCore->retainNamedObject((struct SelModule *)&selCollection, luaL_checkstring(L, 1), 0);
+	if(!col)
+		return 0;
 
+	scl_pushcollection(L, col);
 	return 1;
 }
 
@@ -165,14 +172,31 @@ static struct SelCollectionStorage *scc_create(const char *name, size_t size, si
 	col->full = 0;
 
 		/* Register this collection */
-	if(name)
-		selCore->registerNamedObject((struct SelModule *)&selCollection, (struct _SelNamedObject *)col, strdup(name));
-	else
-		selCore->initObject((struct SelModule *)&selCollection, (struct SelObject *)col);
+	if(name){
+		char *dname = strdup(name);
+		assert(dname);
+		if(!selCore->registerNamedObject((struct SelModule *)&selCollection, (struct _SelNamedObject *)col, dname)){
+			/* Created meanwhile by another thread : use it */
+			pthread_mutex_destroy(&col->mutex);
+			free(col->data);
+			free(col);
+			free(dname);
+			return scc_find(name, 0);
+		}
+	} else
+		selCore->initNamedObject((struct SelModule *)&selCollection, (struct _SelNamedObject *)col);
 
 	return(col);
 }
 
+static void scc_free(struct SelCollectionStorage *col){
+/* Free a collection which is not referenced anymore */
+	pthread_mutex_destroy(&col->mutex);
+	free(col->data);
+	free((void *)col->obj.id.name);
+	free(col);
+}
+
 static int scl_create(lua_State *L){
 	const char *name = lua_tostring(L, 1);	/* Name of the collection */
 	int size, ndata;
@@ -185,15 +209,41 @@ static int scl_create(lua_State *L){
 	if((ndata = lua_tointeger( L, 3 )) < 1)
 		ndata = 1;
 	
-	struct SelCollectionStorage **col = (struct SelCollectionStorage **)lua_newuserdata(L, sizeof(struct SelCollectionStorage));
-	assert(col);
+	struct SelCollectionStorage *col;
+	if(name){
+		while(!(col = (struct SelCollectionStorage *)selCore->retainNamedObject((struct SelModule *)&selCollection, name, 0)))
+			scc_create(name, size, ndata);	/* (Re)create it as it doesn't exist (anymore) */
+	} else {
+		col = scc_create(NULL, size, ndata);
+		selCore->retainObject((struct SelModule *)&selCollection, (struct _SelNamedObject *)col);
+	}
 
-	luaL_getmetatable(L, "SelCollection");
-	lua_setmetatable(L, -2);
+	scl_pushcollection(L, col);
+	return 1;
+}
+
+static int scl_release(lua_State *L){
+/**
+ * Remove the collection from the registry : it can't be found anymore
+ * and is freed as soon as the last reference to it is garbage collected.
+ *
+ * @function Release
+ */
+	struct SelCollectionStorage *col = checkSelCollection(L);
 
-	*col = scc_create(name, size, ndata);
+	if(selCore->unregisterNamedObject((struct SelModule *)&selCollection, (struct _SelNamedObject *)col))
+		scc_free(col);
 
-	return 1;
+	return 0;
+}
+
+static int scl_gc(lua_State *L){
+	struct SelCollectionStorage *col = checkSelCollection(L);
+
+	if(selCore->releaseNamedObject((struct SelModule *)&selCollection, (struct _SelNamedObject *)col))
+		scc_free(col);
+
+	return 0;
 }
 
 static bool scc_push(struct SelCollectionStorage *col, size_t num, ...){
@@ -671,6 +721,8 @@ static const struct luaL_Reg SelCollectionM [] = {
 	{"HowMany", scl_HowMany},
 	{"Save", scl_save},
 	{"Load", scl_load},
+	{"Release", scl_release},
+	{"__gc", scl_gc},
 	{NULL, NULL}
 };
 
@@ -3,14 +3,23 @@
  * Storage that can be enlarged
  *
  * 13/02/2024 - Migrate from v6
+ * 18/10/2026 Bytecode cache of Lua files
  */
 
 #include <Selene/SelElasticStorage.h>
 #include <Selene/SeleneCore.h>
 #include <Selene/SelLog.h>
 
+#include <lauxlib.h>
+
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <assert.h>
 
 static struct SelElasticStorage selElasticStorage;
 
@@ -19,6 +28,8 @@ static struct SelLog *selLog;
 
 #define CHUNK_SIZE 512
 
+static atomic_uint generation;	/* Last storage's generation */
+
 static size_t sesc_init(struct elastic_storage *st){
 /**
  * @brief Initialise elastic storage structure
@@ -29,6 +40,7 @@ static size_t sesc_init(struct elastic_storage *st){
 	st->next = NULL;
 	st->storage_sz = 0;
 	st->name = NULL;
+	st->generation = atomic_fetch_add(&generation, 1) + 1;
 	pthread_mutex_init(&st->mutex, NULL);
 
 	if(!(st->data = malloc(CHUNK_SIZE)))
@@ -59,6 +71,7 @@ static void sesc_free(struct elastic_storage *st){
 		free(st->data);
 	st->data = NULL;
 	st->storage_sz = 0;
+	st->generation = atomic_fetch_add(&generation, 1) + 1;
 
 	pthread_mutex_unlock(&st->mutex);
 }
@@ -99,6 +112,7 @@ static size_t sesc_Feed(struct elastic_storage *st, const void *data, size_t siz
 	}
 
 	memcpy(st->data + st->data_sz, data, size);
+	st->generation = atomic_fetch_add(&generation, 1) + 1;	/* Content changed */
 
 	pthread_mutex_unlock(&st->mutex);
 	return(st->data_sz += size);
@@ -178,6 +192,192 @@ static int sesc_loadsharedfunction(lua_State *L, struct elastic_storage *func){
 	);
 }
 
+	/* ***
+	 * Bytecode cache
+	 *
+	 * Compiled Lua files are kept in SELENE_BYTECODE_CACHE directory (or next
+	 * to the source, with a "c" suffix, if this variable is empty).
+	 * A cached chunk is only used if it has been compiled from the same file,
+	 * with the same modification time and size, by the same Lua version.
+	 * Notez-bien : bytecode is not verified by Lua, the cache directory
+	 * must be trusted.
+	 * ***/
+
+#define BCC_MAGIC "SELC"
+
+struct bccheader {
+	char magic[4];
+	int32_t luaversion;	/* LUA_VERSION_NUM */
+	int64_t mtime;		/* Source's modification time */
+	int64_t mtimens;
+	int64_t size;		/* Source's size */
+	uint32_t keylen;	/* Source's path, following the header */
+};
+
+static char *sesc_cachename(const char *key){
+/* Returns the cache file of the given source or NULL if the cache is disabled.
+ * The result has to be freed.
+ */
+	const char *dir = getenv("SELENE_BYTECODE_CACHE");
+	char *res;
+
+	if(!dir)
+		return NULL;
+
+	if(!*dir){	/* Next to the source */
+		assert( (res = malloc(strlen(key) + 2)) );
+		sprintf(res, "%sc", key);
+	} else {
+		const char *base = strrchr(key, '/');
+		base = base ? base+1 : key;
+
+		assert( (res = malloc(strlen(dir) + strlen(base) + 13)) );	/* "/-%08x.c" */
+		sprintf(res, "%s/%s-%08x.c", dir, base, selL_hash(key));
+	}
+
+	return res;
+}
+
+static void sesc_bccheader(struct bccheader *h, const char *key, struct stat *st){
+	memset(h, 0, sizeof(struct bccheader));	/* Padding included */
+	memcpy(h->magic, BCC_MAGIC, 4);
+	h->luaversion = LUA_VERSION_NUM;
+	h->mtime = st->st_mtim.tv_sec;
+	h->mtimens = st->st_mtim.tv_nsec;
+	h->size = st->st_size;
+	h->keylen = strlen(key);
+}
+
+static bool sesc_readcache(lua_State *L, const char *cname, const char *key, struct stat *st){
+/* Push the cached chunk.
+ * Returns false if there is no usable cache (nothing pushed)
+ */
+	FILE *f = fopen(cname, "r");
+	struct bccheader h, ref;
+	char *buf;
+	long size;
+
+	if(!f)
+		return false;
+
+	sesc_bccheader(&ref, key, st);
+	if(fread(&h, sizeof(h), 1, f) != 1 || memcmp(&h, &ref, sizeof(h))){
+		fclose(f);	/* outdated */
+		return false;
+	}
+
+	if(fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 || fseek(f, sizeof(h), SEEK_SET)){
+		fclose(f);
+		return false;
+	}
+	size -= sizeof(h);
+	if(size <= (long)ref.keylen){
+		fclose(f);
+		return false;
+	}
+
+	assert( (buf = malloc(size)) );
+	if(fread(buf, 1, size, f) != (size_t)size || memcmp(buf, key, ref.keylen)){
+		fclose(f);
+		free(buf);
+		return false;
+	}
+	fclose(f);
+
+	int err = luaL_loadbuffer(L, buf + ref.keylen, size - ref.keylen, key);
+	free(buf);
+
+	if(err){
+		selLog->Log('W', "%s : unusable cache (%s)", cname, lua_tostring(L, -1));
+		lua_pop(L, 1);
+		return false;
+	}
+
+	return true;
+}
+
+static void sesc_writecache(lua_State *L, const char *cname, const char *key, struct stat *st){
+/* Store the function at the top of the stack in the cache.
+ * Failures are only logged : the source will be compiled again next time.
+ */
+	struct elastic_storage bc;
+	struct bccheader h;
+
+	if(!sesc_init(&bc))
+		return;
+
+	if(lua_dump(L, sesc_dumpwriter, &bc
+#if LUA_VERSION_NUM > 501
+		,0	/* Keep debug information for error messages */
+#endif
+	)){
+		selLog->Log('W', "%s : unable to dump compiled code", key);
+		sesc_free(&bc);
+		return;
+	}
+
+	char tmp[strlen(cname) + 16];	/* ".%d" */
+	sprintf(tmp, "%s.%d", cname, (int)getpid());
+
+	FILE *f = fopen(tmp, "w");
+	if(!f){
+		selLog->Log('W', "%s : %s", tmp, strerror(errno));
+		sesc_free(&bc);
+		return;
+	}
+
+	sesc_bccheader(&h, key, st);
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+		&& fwrite(key, 1, h.keylen, f) == h.keylen
+		&& fwrite(bc.data, 1, bc.data_sz, f) == bc.data_sz;
+	ok = !fclose(f) && ok;
+
+	if(!ok || rename(tmp, cname)){
+		selLog->Log('W', "%s : %s", cname, strerror(errno));
+		unlink(tmp);
+	}
+
+	sesc_free(&bc);
+}
+
+static int sesc_loadfile(lua_State *L, const char *path){
+/**
+ * @brief Load a Lua file, using the bytecode cache if enabled
+ *
+ * Same behaviour as luaL_loadfile() : push the compiled chunk or an
+ * error message.
+ *
+ * @function loadfile
+ * @tparam lua_State L
+ * @tparam const char * path of the file
+ * @treturn int 0 or luaL_loadfile()'s error code
+ */
+	struct stat st;
+	char *key;
+	char *cname;
+
+	if(!getenv("SELENE_BYTECODE_CACHE") || stat(path, &st))
+		return luaL_loadfile(L, path);
+
+	if(!(key = realpath(path, NULL)))
+		return luaL_loadfile(L, path);
+	cname = sesc_cachename(key);
+
+	if(sesc_readcache(L, cname, key, &st)){
+		free(cname);
+		free(key);
+		return 0;
+	}
+
+	int err = luaL_loadfile(L, path);
+	if(!err)
+		sesc_writecache(L, cname, key, &st);
+
+	free(cname);
+	free(key);
+	return err;
+}
+
 static void sesc_initSLList(struct elastic_storage_SLList *list){
 /**
  * @brief Initialise a single linked list of storage
@@ -216,6 +416,7 @@ bool InitModule( void ){
 
 	selElasticStorage.dumpwriter = sesc_dumpwriter;
 	selElasticStorage.loadsharedfunction = sesc_loadsharedfunction;
+	selElasticStorage.loadfile = sesc_loadfile;
 	
 	registerModule((struct SelModule *)&selElasticStorage);
 
@@ -14,9 +14,9 @@
 
 struct SelError selError;
 
-struct SeleneCore *selCore;
-struct SelLog *selLog;
-struct SelLua *selLua;
+static struct SeleneCore *selCore;
+static struct SelLog *selLog;
+static struct SelLua *selLua;
 
 static struct selErrorStorage *checkSelError(lua_State *L){
 	void *r = selLua->testudata(L, 1, "SelError");
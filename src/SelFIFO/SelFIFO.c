@@ -7,6 +7,7 @@
  *	26/06/2020	LF : CAUTION userdt changed from int to lua_Number
  *   ---
  *  18/03/2024	LF : Migrate a Séléné v7's module
+ *  18/10/2026	Queues are released when unused
  */
 
 #include <Selene/SelFIFO.h>
@@ -41,17 +42,23 @@ static struct SelFIFOqueue *sfc_find(const char *name, int h){
 	return((struct SelFIFOqueue *)selCore->findNamedObject((struct SelModule *)&selFIFO, name, h));
 }
 
-static int sfl_find(lua_State *L){
-	struct SelFIFOqueue *q = selFIFO.find(luaL_checkstring(L, 1), 0);
-	if(!q)
-		return 0;
-
+static void sfl_pushqueue(lua_State *L, struct SelFIFOqueue *q){
+/* Push a Lua object for a queue we hold a reference on
+ * (released by __gc)
+ */
 	struct SelFIFOqueue **qr = lua_newuserdata(L, sizeof(struct SelFIFOqueue *));
 	assert(qr);
 	luaL_getmetatable(L, "SelFIFO");
 	lua_setmetatable(L, -2);
 	*qr = q;
+}
+
+static int sfl_find(lua_State *L){
+	struct SelFIFOqueue *q = (struct SelFIFOqueue *)selCore->retainNamedObject((struct SelModule *)&selFIFO, luaL_checkstring(L, 1), 0);
+	if(!q)
+		return 0;
 
+	sfl_pushqueue(L, q);
 	return 1;
 }
 
@@ -76,23 +83,68 @@ static struct SelFIFOqueue*sfc_create(const char *name){
 	pthread_mutex_init(&q->mutex, NULL);
 
 		/* Register this queue */
-	selCore->registerNamedObject((struct SelModule *)&selFIFO, (struct _SelNamedObject *)q, strdup(name));
+	char *dname = strdup(name);
+	assert(dname);
+	if(!selCore->registerNamedObject((struct SelModule *)&selFIFO, (struct _SelNamedObject *)q, dname)){
+		/* Created meanwhile by another thread : use it */
+		pthread_mutex_destroy(&q->mutex);
+		free(q);
+		free(dname);
+		return sfc_find(name, h);
+	}
 
 	return q;
 }
 
-static int sfl_create(lua_State *L){
-	struct SelFIFOqueue **q = lua_newuserdata(L, sizeof(struct SelFIFOqueue *));
-	assert(q);
-	luaL_getmetatable(L, "SelFIFO");
-	lua_setmetatable(L, -2);
+static void sfc_free(struct SelFIFOqueue *q){
+/* Free a queue which is not referenced anymore */
+	struct SelFIFOCItem *it, *next;
 
+	for(it = q->first; it; it = next){
+		next = it->next;
+		selFIFO.freeItem(it);
+	}
+
+	pthread_mutex_destroy(&q->mutex);
+	free((void *)q->obj.id.name);
+	free(q);
+}
+
+static int sfl_create(lua_State *L){
 	const char *n = luaL_checkstring(L, 1);	/* Name of the Fifo */
-	*q = sfc_create(n);
+	struct SelFIFOqueue *q;
+
+	while(!(q = (struct SelFIFOqueue *)selCore->retainNamedObject((struct SelModule *)&selFIFO, n, 0)))
+		sfc_create(n);	/* (Re)create it as it doesn't exist (anymore) */
 
+	sfl_pushqueue(L, q);
 	return 1;
 }
 
+static int sfql_release(lua_State *L){
+/**
+ * Remove the queue from the registry : it can't be found anymore
+ * and is freed as soon as the last reference to it is garbage collected.
+ *
+ * @function Release
+ */
+	struct SelFIFOqueue *q = *checkSelFIFO(L);
+
+	if(selCore->unregisterNamedObject((struct SelModule *)&selFIFO, (struct _SelNamedObject *)q))
+		sfc_free(q);
+
+	return 0;
+}
+
+static int sfql_gc(lua_State *L){
+	struct SelFIFOqueue *q = *checkSelFIFO(L);
+
+	if(selCore->releaseNamedObject((struct SelModule *)&selFIFO, (struct _SelNamedObject *)q))
+		sfc_free(q);
+
+	return 0;
+}
+
 static bool sfc_pushS(struct SelFIFOqueue *q, const char *s, lua_Number udata){
 /**
  * Push a new item in a queue
@@ -314,6 +366,8 @@ static const struct luaL_Reg SelFIFOM [] = {
 	{"list", sff_list},
 #endif
 	{"dump", sfql_dump},
+	{"Release", sfql_release},
+	{"__gc", sfql_gc},
 	{NULL, NULL}
 };
 
@@ -145,7 +145,9 @@ static bool slc_Log(const char level, const char *message, ...){
 		vsnprintf(t, MAXMSG, message, args);
 		va_end(args);
 
-		selMQTT->mqttpublish(sl_MQTT_client, ttopic, strlen(t), (void *)t, 0);
+			/* Queued : logging doesn't wait for the broker */
+		struct SelMQTTMessage msg = { ttopic, t, strlen(t), 0, 0 };
+		selMQTT->mqttpublishv(sl_MQTT_client, &msg, 1, LUA_REFNIL, TO_MULTIPLE);
 	}
 	
 	return true;
@@ -9,8 +9,11 @@
  * Séléné, where Séléné acts as a core component and manages all the aspects.
  *
  * 06/02/2024 First version
+ * 18/10/2026 initLua, late dependencies and startup functions traced
  */
 
+#define _GNU_SOURCE	/* dladdr() */
+
 #include <Selene/SelLua.h>
 #include <Selene/SeleneCore.h>
 #include <Selene/SelLog.h>
@@ -21,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <dlfcn.h>		/* dladdr() */
 
 struct SelLua sl_selLua;
 
@@ -245,8 +249,11 @@ static int ssl_Use(lua_State *L){
 	m = sl_selCore->loadModule(name, 0, &verfound, 'E');	/* load it */
 
 	if(m){
-		if(m->initLua)
+		if(m->initLua){
+			uint64_t t = selL_traceBegin();
 			m->initLua(&sl_selLua);
+			selL_traceEnd(t, "initLua", m->name.name);
+		}
 		lua_pushboolean(L, 1);
 	} else
 		lua_pushboolean(L, 0);
@@ -256,8 +263,11 @@ static int ssl_Use(lua_State *L){
 static void slc_lateBuildingDependancies(lua_State *L){
 	for(struct SelModule *m = modules; m; m=m->next){	/* Ensure all dependencies are met */
 		if(!m->checkdependencies()){
-			if(m->laterebuilddependancies)
+			if(m->laterebuilddependancies){
+				uint64_t t = selL_traceBegin();
 				m->laterebuilddependancies();
+				selL_traceEnd(t, "laterebuilddependancies", m->name.name);
+			}
 		}
 	}
 }
@@ -327,6 +337,8 @@ static struct startupFunc {
 	void (*func)( lua_State * );	/* Function to launch */
 } *startuplist = NULL, *sllast = NULL;
 
+static unsigned int startupgen = 0;	/* Bumped each time the list changes */
+
 static void slc_AddStartupFunc(void (*func)(lua_State *)){
 /**
  * @brief Add a function to slave's startup list
@@ -344,6 +356,21 @@ static void slc_AddStartupFunc(void (*func)(lua_State *)){
 	if(!startuplist)	/* First defined */
 		startuplist = new;
 	sllast = new;
+
+	startupgen++;
+}
+
+static unsigned int slc_getStartupGeneration(void){
+/**
+ * @brief Startup list's generation
+ *
+ * Changes each time a startup function is added : slave states
+ * initialised with another generation miss some functions.
+ *
+ * @function getStartupGeneration
+ * @treturn integer generation
+ */
+	return startupgen;
 }
 
 static void slc_ApplyStartupFunc(lua_State *L){
@@ -354,8 +381,16 @@ static void slc_ApplyStartupFunc(lua_State *L){
  */
 	struct startupFunc *lst = startuplist;
 
-	for(;lst; lst = lst->next)
+	for(;lst; lst = lst->next){
+		uint64_t t = selL_traceBegin();
 		lst->func(L);
+
+		if(t){	/* Functions are static : only the object they belong to is known */
+			Dl_info info;
+			selL_traceEnd(t, "StartupFunc",
+				(dladdr((void *)lst->func, &info) && info.dli_fname) ? info.dli_fname : "?");
+		}
+	}
 }
 
 /* ***
@@ -392,6 +427,7 @@ bool InitModule( void ){
 
 	sl_selLua.AddStartupFunc = slc_AddStartupFunc;
 	sl_selLua.ApplyStartupFunc = slc_ApplyStartupFunc;
+	sl_selLua.getStartupGeneration = slc_getStartupGeneration;
 
 	sl_selLua.lateBuildingDependancies = slc_lateBuildingDependancies;
 
@@ -407,8 +443,11 @@ bool InitModule( void ){
 
 		/* Link with already loaded module */
 	for(struct SelModule *m = modules; m; m = m->next){
-		if(m->initLua)
+		if(m->initLua){
+			uint64_t t = selL_traceBegin();
 			m->initLua(&sl_selLua);
+			selL_traceEnd(t, "initLua", m->name.name);
+		}
 	}
 	
 	registerSelene(NULL);
@@ -12,6 +12,9 @@ Have a look on **SeleMQTT** when the connection has to be managed externally.
  * 21/01/2015 LF : Rename as SelMQTT
  * 11/04/2021 LF : add retained and dupplicate parameters to callback receiving function
  * 03/02/2024 LF : Switch to Selene v7
+ * 18/10/2026 Per topic long-lived workers
+ * 18/10/2026 Background publisher and PublishBatch()
+ * 18/10/2026 Publish coalescing
  
  */
 
@@ -30,6 +33,10 @@ Have a look on **SeleMQTT** when the connection has to be managed externally.
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
 
 static struct SelMQTT selMQTT;
 
@@ -38,9 +45,9 @@ static struct SelLog *selLog;
 static struct SelLua *selLua;
 static struct SelMultitasking *selMultitasking;
 static struct SelScripting *selScripting;
-struct SelElasticStorage *selElasticStorage;
-struct SelSharedVar *selSharedVar;
-struct SelTimer *selTimer;
+static struct SelElasticStorage *selElasticStorage;
+static struct SelSharedVar *selSharedVar;
+static struct SelTimer *selTimer;
 
 static bool sqc_checkdependencies(){	/* Ensure all dependancies are met */
 	return(!!selTimer);
@@ -72,26 +79,633 @@ struct _topic {
 	struct elastic_storage *func;	/* Arrival callback function (run in dedicated context) */
 	int trigger;			/* application side trigger function */
 	enum TaskOnce trigger_once;	/* Avoid duplicates in waiting list */
+	struct topicworker *worker;	/* Long-lived worker (NULL if func runs in a detached thread) */
+	bool rawpayload;		/* func receives a SelMQTTPayload instead of a string */
 };
 
-static int sqc_mqttpublish(MQTTClient client, const char *topic, int length, void *payload, int retained){
+/*
+ * Received message
+ *
+ * Paho's message is shared by all consumers (detached functions, workers,
+ * SelMQTTPayload objects) without copy, and released by the last one.
+ */
+struct mqttpayload {
+	atomic_int refs;
+	char *topic;
+	MQTTClient_message *msg;
+};
+
+static struct mqttpayload *sqc_payloadref(struct mqttpayload *pl){
+	atomic_fetch_add(&pl->refs, 1);
+	return pl;
+}
+
+static void sqc_payloadrelease(struct mqttpayload *pl){
+	if(atomic_fetch_sub(&pl->refs, 1) == 1){	/* Last reference */
+		MQTTClient_freeMessage(&pl->msg);
+		MQTTClient_free(pl->topic);
+		free(pl);
+	}
+}
+
+static void sqc_pushpayload(lua_State *L, struct mqttpayload *pl, bool raw){
+/* Push the payload, as a string or a SelMQTTPayload */
+	if(raw){
+		struct mqttpayload **p = (struct mqttpayload **)lua_newuserdata(L, sizeof(struct mqttpayload *));
+		*p = sqc_payloadref(pl);
+		luaL_getmetatable(L, "SelMQTTPayload");
+		lua_setmetatable(L, -2);
+	} else
+		lua_pushlstring(L, pl->msg->payload, pl->msg->payloadlen);
+}
+
+/*
+ * Long-lived worker
+ *
+ * Messages are queued and handled in order by a dedicated thread, with
+ * a persistent state : the callback's globals survive between messages.
+ */
+struct workermsg {
+	struct workermsg *next;
+	struct mqttpayload *pl;
+};
+
+struct topicworker {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;	/* Signaled when a message is queued */
+	struct workermsg *first, *last;
+	unsigned int queued;	/* Number of pending messages */
+	unsigned int maxqueue;	/* Oldest messages are dropped beyond */
+	unsigned long int dropped;
+
+	lua_State *L;	/* Persistent state */
+	int funcref;	/* Callback in this state */
+	struct _topic *tp;	/* Subscription */
+};
+
+static void *sqc_topicworker(void *a){
+	struct topicworker *w = a;
+
+	for(;;){
+		pthread_mutex_lock(&w->mutex);
+		while(!w->first)
+			pthread_cond_wait(&w->cond, &w->mutex);
+
+		struct workermsg *msg = w->first;
+		if(!(w->first = msg->next))
+			w->last = NULL;
+		w->queued--;
+		pthread_mutex_unlock(&w->mutex);
+
+		lua_rawgeti(w->L, LUA_REGISTRYINDEX, w->funcref);
+		lua_pushstring(w->L, msg->pl->topic);		/* 1: topic */
+		sqc_pushpayload(w->L, msg->pl, w->tp->rawpayload);	/* 2: payload */
+		lua_pushboolean(w->L, msg->pl->msg->retained);	/* 3: Retained */
+		lua_pushboolean(w->L, msg->pl->msg->dup);		/* 4: duplicated message */
+		sqc_payloadrelease(msg->pl);
+		free(msg);
+
+		if(lua_pcall(w->L, 4, 1, 0))
+			selLog->Log('E', "(MQTT worker) %s", lua_tostring(w->L, -1));
+		else if(w->tp->trigger != LUA_REFNIL && selScripting && lua_toboolean(w->L, -1))
+			selScripting->pushtask(w->tp->trigger, w->tp->trigger_once);
+		lua_settop(w->L, 0);
+	}
+
+	return NULL;
+}
+
+static struct topicworker *sqc_createworker(struct _topic *tp, unsigned int maxqueue){
+/* Create and launch a worker for the subscription
+ * -> NULL in case of error (logged)
+ */
+	struct topicworker *w = malloc(sizeof(struct topicworker));
+	assert(w);
+
+	pthread_mutex_init(&w->mutex, NULL);
+	pthread_cond_init(&w->cond, NULL);
+	w->first = w->last = NULL;
+	w->queued = 0;
+	w->maxqueue = maxqueue;
+	w->dropped = 0;
+	w->tp = tp;
+
+	w->L = selMultitasking->createSlaveState();
+	int err;
+	if((err = selElasticStorage->loadsharedfunction(w->L, tp->func))){
+		selLog->Log('E', "Can't load worker's function for '%s' : %s", tp->topic, (err == LUA_ERRSYNTAX) ? "Syntax error" : "Memory error");
+		selMultitasking->releaseSlaveState(w->L);
+		free(w);
+		return NULL;
+	}
+	w->funcref = luaL_ref(w->L, LUA_REGISTRYINDEX);
+
+	pthread_t tid;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	err = pthread_create(&tid, &attr, sqc_topicworker, w);
+	pthread_attr_destroy(&attr);
+	if(err){
+		selLog->Log('E', "Can't create worker for '%s' : %s", tp->topic, strerror(err));
+		selMultitasking->releaseSlaveState(w->L);
+		free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+static void sqc_queuemsg(struct topicworker *w, struct mqttpayload *pl){
+/* Queue a message to a worker */
+	struct workermsg *msg = malloc(sizeof(struct workermsg));
+	assert(msg);
+
+	msg->next = NULL;
+	msg->pl = sqc_payloadref(pl);
+
+	struct workermsg *drop = NULL;
+
+	pthread_mutex_lock(&w->mutex);
+	if(w->maxqueue && w->queued >= w->maxqueue){	/* Drop the oldest message */
+		drop = w->first;
+		if(!(w->first = drop->next))
+			w->last = NULL;
+		w->queued--;
+		w->dropped++;
+	}
+
+	if(w->last)
+		w->last->next = msg;
+	else
+		w->first = msg;
+	w->last = msg;
+	w->queued++;
+
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->mutex);
+
+	if(drop){
+		selLog->Log('W', "MQTT worker for '%s' is overloaded : message dropped", w->tp->topic);
+		sqc_payloadrelease(drop->pl);
+		free(drop);
+	}
+}
+
+/*
+ * Subscriptions' index
+ *
+ * Subscriptions are indexed in a trie, one node per topic's level, so
+ * the subscriptions matching a topic are found in a time proportional to
+ * its depth.
+ */
+struct topicmatch {
+	struct topicmatch *next;
+	struct _topic *tp;
+};
+
+struct topicnode {
+	char *level;		/* This level's name (not NUL terminated) */
+	size_t len;
+	struct topicnode **children;	/* Sorted by level */
+	unsigned int nchildren;
+	struct topicnode *plus;			/* '+' child */
+	struct topicmatch *subs;		/* Subscriptions ending at this level */
+	struct topicmatch *hash;		/* Subscriptions ending with '#' after this level */
+};
+
+static struct topicnode *sqc_newnode(const char *level, size_t len){
+	struct topicnode *n = calloc(1, sizeof(struct topicnode));
+	assert(n);
+
+	if(len){
+		assert((n->level = malloc(len)));
+		memcpy(n->level, level, len);
+	}
+	n->len = len;
+
+	return n;
+}
+
+static int sqc_levelcmp(const char *level, size_t len, struct topicnode *n){
+	int r = memcmp(level, n->level, len < n->len ? len : n->len);
+	if(r)
+		return r;
+	return (len > n->len) - (len < n->len);
+}
+
+static struct topicnode *sqc_findchild(struct topicnode *n, const char *level, size_t len, unsigned int *pos){
+/* Binary search of a child.
+ * If not found, pos is where it would be inserted
+ */
+	unsigned int lo = 0, hi = n->nchildren;
+
+	while(lo < hi){
+		unsigned int mid = (lo + hi) / 2;
+		int r = sqc_levelcmp(level, len, n->children[mid]);
+		if(!r)
+			return n->children[mid];
+		if(r < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	if(pos)
+		*pos = lo;
+	return NULL;
+}
+
+static void sqc_addmatch(struct topicmatch **lst, struct _topic *tp){
+	struct topicmatch *m = malloc(sizeof(struct topicmatch));
+	assert(m);
+
+	m->tp = tp;
+	m->next = *lst;
+	*lst = m;
+}
+
+static void sqc_trieinsert(struct topicnode **root, struct _topic *tp){
+/* Index a subscription */
+	if(!*root)
+		*root = sqc_newnode(NULL, 0);
+
+	struct topicnode *n = *root;
+	const char *t = tp->topic;
+
+	for(;;){
+		const char *end = strchr(t, '/');
+		size_t len = end ? (size_t)(end - t) : strlen(t);
+
+		if(len == 1 && *t == '#'){	/* Multi-level wildcard : last level */
+			sqc_addmatch(&n->hash, tp);
+			return;
+		} else if(len == 1 && *t == '+'){
+			if(!n->plus)
+				n->plus = sqc_newnode(t, len);
+			n = n->plus;
+		} else {
+			unsigned int pos;
+			struct topicnode *c = sqc_findchild(n, t, len, &pos);
+
+			if(!c){	/* New level */
+				c = sqc_newnode(t, len);
+				n->children = realloc(n->children, sizeof(struct topicnode *) * (n->nchildren + 1));
+				assert(n->children);
+				memmove(&n->children[pos + 1], &n->children[pos], sizeof(struct topicnode *) * (n->nchildren - pos));
+				n->children[pos] = c;
+				n->nchildren++;
+			}
+			n = c;
+		}
+
+		if(!end)
+			break;
+		t = end + 1;
+	}
+
+	sqc_addmatch(&n->subs, tp);
+}
+
+static void sqc_triematch(struct topicnode *n, const char *t, void (*func)(struct _topic *, void *), void *arg){
+/* Call func() for every subscription matching topic t
+ * (t is NULL when all levels have been consumed)
+ */
+	struct topicmatch *m;
+
+	for(m = n->hash; m; m = m->next)	/* '#' matches remaining levels, if any */
+		func(m->tp, arg);
+
+	if(!t){	/* End of the topic */
+		for(m = n->subs; m; m = m->next)
+			func(m->tp, arg);
+		return;
+	}
+
+	const char *end = strchr(t, '/');
+	size_t len = end ? (size_t)(end - t) : strlen(t);
+	const char *next = end ? end + 1 : NULL;
+
+	struct topicnode *c = sqc_findchild(n, t, len, NULL);
+	if(c)
+		sqc_triematch(c, next, func, arg);
+	if(n->plus)
+		sqc_triematch(n->plus, next, func, arg);
+}
+
+	/*
+	 * Background publisher
+	 *
+	 * Messages are queued and published by a dedicated thread, so callers
+	 * never wait for the network. At most "window" QoS 1/2 messages are
+	 * kept in flight : the publisher waits for their delivery before
+	 * sending more.
+	 */
+
+struct pubbatch {	/* Messages published together */
+	atomic_uint remaining;	/* Messages not yet delivered */
+	int trigger;			/* pushed when the whole batch is delivered */
+	enum TaskOnce trigger_once;
+};
+
+struct pubmsg {
+	struct pubmsg *next;
+	MQTTClient client;
+	char *topic;
+	void *payload;
+	int length;
+	int qos;
+	int retained;
+	struct pubbatch *batch;	/* NULL if nothing to trigger */
+};
+
+struct inflight {
+	MQTTClient client;
+	MQTTClient_deliveryToken token;
+	struct pubbatch *batch;
+	bool delivered;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;	/* Signaled when a message is queued or delivered */
+	bool running;			/* Is the publishing thread started ? */
+	bool checkpending;		/* A delivery has been notified */
+
+	struct pubmsg *first, *last;	/* Pending messages */
+	unsigned int queued;
+
+	struct inflight *inflight;	/* Messages waiting for their delivery */
+	unsigned int ninflight;
+	unsigned int size;		/* allocated inflight entries */
+
+		/* Configuration */
+	unsigned int maxqueue;	/* Maximum number of pending messages (0 : unlimited) */
+	unsigned int window;	/* Maximum number of messages in flight */
+
+		/* Statistics */
+	unsigned long int published;
+	unsigned long int delivered;
+	unsigned long int failed;
+	unsigned long int dropped;
+	unsigned long long int bytes;
+	unsigned int peakqueue;
+	unsigned int peakinflight;
+} publisher = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.maxqueue = 4096,
+	.window = 32
+};
+
+#define PUBPOLL_MS 100	/* Delivery polling period when deliveries are not notified */
+
+static void sqc_batchdone(struct pubbatch *b){
+/* One message of the batch is over */
+	if(b && atomic_fetch_sub(&b->remaining, 1) == 1){
+		if(selScripting)
+			selScripting->pushtask(b->trigger, b->trigger_once);
+		free(b);
+	}
+}
+
+static void sqc_pollinflight(void){
+/* Remove delivered messages from the in-flight list.
+ * Delivered messages are the ones not pending anymore at Paho's side.
+ * -> Called with publisher.mutex locked
+ */
+	unsigned int i, j;
+
+		/* Mark delivered messages, client by client */
+	for(i = 0; i < publisher.ninflight; i++){
+		MQTTClient client = publisher.inflight[i].client;
+		MQTTClient_deliveryToken *pending = NULL;
+
+		for(j = 0; j < i; j++)
+			if(publisher.inflight[j].client == client)
+				break;
+		if(j < i)	/* Already checked */
+			continue;
+
+		if(MQTTClient_getPendingDeliveryTokens(client, &pending) != MQTTCLIENT_SUCCESS)
+			continue;
+
+		for(j = i; j < publisher.ninflight; j++){
+			if(publisher.inflight[j].client != client)
+				continue;
+
+			publisher.inflight[j].delivered = true;
+			if(pending)
+				for(MQTTClient_deliveryToken *t = pending; *t != -1; t++)
+					if(*t == publisher.inflight[j].token){
+						publisher.inflight[j].delivered = false;
+						break;
+					}
+		}
+
+		if(pending)
+			MQTTClient_free(pending);
+	}
+
+		/* Remove them */
+	for(i = j = 0; i < publisher.ninflight; i++){
+		if(publisher.inflight[i].delivered){
+			sqc_batchdone(publisher.inflight[i].batch);
+			publisher.delivered++;
+		} else
+			publisher.inflight[j++] = publisher.inflight[i];
+	}
+	publisher.ninflight = j;
+}
+
+static void *sqc_publisher(void *unused){
+	(void)unused;
+
+	pthread_mutex_lock(&publisher.mutex);
+	for(;;){
+		if(publisher.checkpending || publisher.ninflight >= publisher.window){
+			publisher.checkpending = false;
+			sqc_pollinflight();
+		}
+
+		if(!publisher.first || publisher.ninflight >= publisher.window){
+				/* Nothing to send or window full : wait for an event */
+			if(!publisher.ninflight)
+				pthread_cond_wait(&publisher.cond, &publisher.mutex);
+			else {	/* Deliveries of externally managed clients are not notified */
+				struct timespec ts;
+				clock_gettime(CLOCK_REALTIME, &ts);
+				ts.tv_nsec += PUBPOLL_MS * 1000000L;
+				if(ts.tv_nsec >= 1000000000L){
+					ts.tv_sec++;
+					ts.tv_nsec -= 1000000000L;
+				}
+				if(pthread_cond_timedwait(&publisher.cond, &publisher.mutex, &ts) == ETIMEDOUT)
+					publisher.checkpending = true;
+			}
+			continue;
+		}
+
+		struct pubmsg *msg = publisher.first;
+		if(!(publisher.first = msg->next))
+			publisher.last = NULL;
+		publisher.queued--;
+		pthread_mutex_unlock(&publisher.mutex);
+
+			/* Publishing is done outside the lock as it may block */
+		MQTTClient_message pubmsg = MQTTClient_message_initializer;
+		MQTTClient_deliveryToken token;
+		pubmsg.retained = msg->retained;
+		pubmsg.qos = msg->qos;
+		pubmsg.payloadlen = msg->length;
+		pubmsg.payload = msg->payload;
+
+		int err = MQTTClient_publishMessage(msg->client, msg->topic, &pubmsg, &token);
+
+		pthread_mutex_lock(&publisher.mutex);
+		if(err != MQTTCLIENT_SUCCESS){
+				/* Not logged : SelLog itself may publish through us */
+			publisher.failed++;
+			sqc_batchdone(msg->batch);
+		} else {
+			publisher.published++;
+			publisher.bytes += msg->length;
+
+			if(msg->qos){	/* Wait for its acknowledgement */
+				publisher.inflight[publisher.ninflight].client = msg->client;
+				publisher.inflight[publisher.ninflight].token = token;
+				publisher.inflight[publisher.ninflight].batch = msg->batch;
+				publisher.inflight[publisher.ninflight].delivered = false;
+				if(++publisher.ninflight > publisher.peakinflight)
+					publisher.peakinflight = publisher.ninflight;
+			} else {	/* QoS 0 : done as soon as sent */
+				publisher.delivered++;
+				sqc_batchdone(msg->batch);
+			}
+		}
+		free(msg);
+	}
+
+	return NULL;
+}
+
+static void sqc_delivered(void *actx, MQTTClient_deliveryToken dt){
+/* Paho's delivery notification */
+	(void)actx;
+	(void)dt;
+
+	pthread_mutex_lock(&publisher.mutex);
+	publisher.checkpending = true;
+	pthread_cond_signal(&publisher.cond);
+	pthread_mutex_unlock(&publisher.mutex);
+}
+
+static int sqc_mqttpublishv(MQTTClient client, const struct SelMQTTMessage *msgs, unsigned int nbre, int trigger, enum TaskOnce trigger_once){
 /**
- * @brief Publish a message to a given topic.
+ * @brief Queue messages to be published by the background publisher.
  *
- * @function mqttpublish
+ * Messages are copied : arguments can be released as soon as the function
+ * returns. Messages that don't fit in the queue are dropped.
+ *
+ * @function mqttpublishv
  * @tparam MQTTClient MQTT client handle
- * @tparam string Topic to publish to
- * @tparam int payload length
- * @tparam void * payload to publish
- * @tparam int true if the document is retained
- * @return result of the publishing (see MQTTClient_publishMessage)
+ * @tparam struct SelMQTTMessage * messages to publish
+ * @tparam unsigned int number of messages
+ * @tparam int trigger pushed in the todo list when all messages are delivered (LUA_REFNIL if none)
+ * @tparam enum TaskOnce how the trigger is pushed
+ * @return number of queued messages
  */
-	MQTTClient_message pubmsg = MQTTClient_message_initializer;
-	pubmsg.retained = retained;
-	pubmsg.payloadlen = length;
-	pubmsg.payload = payload;
+	struct pubbatch *batch = NULL;
+	unsigned int i, n = nbre;
 
-	return MQTTClient_publishMessage(client, topic, &pubmsg, NULL);
+	pthread_mutex_lock(&publisher.mutex);
+
+	if(!publisher.running){	/* Launch the publisher */
+		pthread_t tid;
+
+		if(publisher.window > publisher.size){
+			assert( (publisher.inflight = realloc(publisher.inflight, sizeof(struct inflight) * publisher.window)) );
+			publisher.size = publisher.window;
+		}
+
+		if(pthread_create(&tid, NULL, sqc_publisher, NULL)){
+				/* Not logged : SelLog itself may publish through us */
+			publisher.dropped += nbre;
+			pthread_mutex_unlock(&publisher.mutex);
+			return 0;
+		}
+		pthread_detach(tid);
+		publisher.running = true;
+	}
+
+	if(publisher.maxqueue && publisher.queued + n > publisher.maxqueue){	/* Queue full */
+		n = (publisher.queued < publisher.maxqueue) ? publisher.maxqueue - publisher.queued : 0;
+		publisher.dropped += nbre - n;
+	}
+
+	if(n && trigger != LUA_REFNIL){
+		assert( (batch = malloc(sizeof(struct pubbatch))) );
+		atomic_init(&batch->remaining, n);
+		batch->trigger = trigger;
+		batch->trigger_once = trigger_once;
+	}
+
+	for(i = 0; i < n; i++){
+		size_t tlen = strlen(msgs[i].topic) + 1;
+		struct pubmsg *msg = malloc(sizeof(struct pubmsg) + tlen + msgs[i].length);
+		assert(msg);
+
+		msg->next = NULL;
+		msg->client = client;
+		msg->topic = (char *)(msg + 1);
+		memcpy(msg->topic, msgs[i].topic, tlen);
+		msg->payload = msg->topic + tlen;
+		memcpy(msg->payload, msgs[i].payload, msgs[i].length);
+		msg->length = msgs[i].length;
+		msg->qos = msgs[i].qos;
+		msg->retained = msgs[i].retained;
+		msg->batch = batch;
+
+		if(publisher.last)
+			publisher.last->next = msg;
+		else
+			publisher.first = msg;
+		publisher.last = msg;
+
+		if(++publisher.queued > publisher.peakqueue)
+			publisher.peakqueue = publisher.queued;
+	}
+
+	pthread_cond_signal(&publisher.cond);
+	pthread_mutex_unlock(&publisher.mutex);
+
+	return n;
+}
+
+static bool sqc_configurePublisher(unsigned int queue, unsigned int window){
+/**
+ * @brief Configure the background publisher
+ *
+ * @function configurePublisher
+ * @tparam unsigned int queue maximum number of pending messages (0 : unlimited)
+ * @tparam unsigned int window maximum number of QoS 1/2 messages in flight
+ * @treturn boolean false if arguments are invalid
+ */
+	if(!window)
+		return false;
+
+	pthread_mutex_lock(&publisher.mutex);
+	if(window > publisher.size){
+		assert( (publisher.inflight = realloc(publisher.inflight, sizeof(struct inflight) * window)) );
+		publisher.size = window;
+	}
+	publisher.maxqueue = queue;
+	publisher.window = window;
+
+	pthread_cond_signal(&publisher.cond);	/* The window may be larger */
+	pthread_mutex_unlock(&publisher.mutex);
+
+	return true;
 }
 
 static int sqc_mqtttokcmp(register const char *s, register const char *t){
@@ -131,6 +745,346 @@ static int sqc_mqtttokcmp(register const char *s, register const char *t){
 	return(*s - *t);
 }
 
+	/*
+	 * Publish coalescing
+	 *
+	 * Messages published with mqttpublish() to topics matching a coalescing
+	 * rule are rate limited : at most one message is sent per window,
+	 * intermediate values being replaced by the latest one, which is flushed
+	 * by a dedicated thread when the window is over.
+	 * Messages queued with mqttpublishv() (PublishBatch() and SelLog) are
+	 * not coalesced.
+	 * Both this flush and the publishing of a value arriving after the
+	 * window are done synchronously, under coalescer.mutex : a topic's
+	 * values reach the broker in order, so the last one (and the retained
+	 * one) is the latest. A value is only considered as sent if the
+	 * publishing succeeded.
+	 * The same thread frees topics idle for longer than their window plus
+	 * COALESCE_GRACE, so short-lived topics don't accumulate.
+	 */
+
+struct coalescerule {
+	struct coalescerule *next;
+	char *filter;			/* Topic filter (MQTT wildcards allowed) */
+	unsigned long int window;	/* ms (0 : not coalesced) */
+	bool onlychanged;		/* Don't publish unchanged values */
+};
+
+struct coalescebuf {
+	void *data;
+	int length;
+	int retained;
+	size_t allocated;
+};
+
+struct coalesced {	/* Coalesced topic */
+	struct coalesced *next;		/* Hash bucket */
+	struct coalesced *pnext;	/* Pending list */
+	MQTTClient client;
+	char *topic;
+	unsigned int H;
+	struct coalescerule *rule;
+
+	bool pending;		/* value waiting for the end of the window */
+	unsigned long long int lastsent;	/* ms */
+	struct coalescebuf value;	/* Latest value */
+	struct coalescebuf sent;	/* Last published value */
+};
+
+#define COALESCE_BUCKETS 64
+#define COALESCE_GRACE 60000	/* ms an idle topic is kept after its window */
+#define COALESCE_SWEEP 10000	/* ms between idle topics reclaiming */
+
+static atomic_bool coalescing;	/* Is there any rule ? */
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;	/* Signaled when a topic becomes pending */
+	bool running;			/* Is the flushing thread started ? */
+
+	struct coalescerule *rules, *lastrule;	/* Rules in declaration order */
+	struct coalesced *buckets[COALESCE_BUCKETS];
+	unsigned int topics;	/* Number of known topics */
+	struct coalesced *pending;
+	unsigned long long int nextsweep;	/* ms */
+
+		/* Statistics */
+	unsigned long int coalesced;	/* Values replaced before being sent */
+	unsigned long int unchanged;	/* Values not sent as unchanged */
+	unsigned long int flushed;		/* Values sent at the end of the window */
+} coalescer = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER
+};
+
+static unsigned long long int sqc_now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long int)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sqc_setbuf(struct coalescebuf *b, const void *data, int length, int retained){
+	if((size_t)length > b->allocated){
+		assert( (b->data = realloc(b->data, length)) );
+		b->allocated = length;
+	}
+	memcpy(b->data, data, length);
+	b->length = length;
+	b->retained = retained;
+}
+
+static bool sqc_samebuf(struct coalescebuf *b, const void *data, int length, int retained){
+	return(b->data && b->length == length && b->retained == retained && !memcmp(b->data, data, length));
+}
+
+static int sqc_publishnow(MQTTClient client, const char *topic, int length, const void *payload, int retained){
+	MQTTClient_message pubmsg = MQTTClient_message_initializer;
+	pubmsg.retained = retained;
+	pubmsg.payloadlen = length;
+	pubmsg.payload = (void *)payload;
+
+	return MQTTClient_publishMessage(client, topic, &pubmsg, NULL);
+}
+
+static void sqc_reclaim(unsigned long long int now){
+/* Free topics idle for longer than their window plus the grace period.
+ * coalescer.mutex has to be held
+ */
+	for(unsigned int i = 0; i < COALESCE_BUCKETS; i++){
+		for(struct coalesced **p = &coalescer.buckets[i]; *p; ){
+			struct coalesced *e = *p;
+
+			if(e->pending || now < e->lastsent + e->rule->window + COALESCE_GRACE){
+				p = &e->next;
+				continue;
+			}
+
+			*p = e->next;
+			free(e->topic);
+			free(e->value.data);
+			free(e->sent.data);
+			free(e);
+			coalescer.topics--;
+		}
+	}
+}
+
+static void *sqc_flusher(void *unused){
+	(void)unused;
+
+	pthread_mutex_lock(&coalescer.mutex);
+	for(;;){
+		unsigned long long int now = sqc_now(), earliest = 0;
+
+		for(struct coalesced **p = &coalescer.pending; *p; ){
+			struct coalesced *e = *p;
+			unsigned long long int deadline = e->lastsent + e->rule->window;
+
+			if(deadline > now){
+				if(!earliest || deadline < earliest)
+					earliest = deadline;
+				p = &e->pnext;
+				continue;
+			}
+
+			if(e->rule->onlychanged && sqc_samebuf(&e->sent, e->value.data, e->value.length, e->value.retained))
+				coalescer.unchanged++;
+			else if(sqc_publishnow(e->client, e->topic, e->value.length, e->value.data, e->value.retained) != MQTTCLIENT_SUCCESS){
+				e->lastsent = now;	/* Kept pending : retried after a window */
+				if(!earliest || now + e->rule->window < earliest)
+					earliest = now + e->rule->window;
+				p = &e->pnext;
+				continue;
+			} else {
+				struct coalescebuf t = e->sent;	/* The value becomes the sent one */
+				e->sent = e->value;
+				e->value = t;
+				e->lastsent = now;
+				coalescer.flushed++;
+			}
+
+			*p = e->pnext;	/* Remove from pending list */
+			e->pending = false;
+		}
+
+		if(coalescer.topics){	/* Reclaim idle topics */
+			if(now >= coalescer.nextsweep){
+				sqc_reclaim(now);
+				coalescer.nextsweep = now + COALESCE_SWEEP;
+			}
+			if(coalescer.topics && (!earliest || coalescer.nextsweep < earliest))
+				earliest = coalescer.nextsweep;
+		}
+
+		if(!earliest)	/* Nothing pending */
+			pthread_cond_wait(&coalescer.cond, &coalescer.mutex);
+		else {
+			struct timespec ts;
+			ts.tv_sec = earliest / 1000;
+			ts.tv_nsec = (earliest % 1000) * 1000000L;
+			pthread_cond_timedwait(&coalescer.cond, &coalescer.mutex, &ts);
+		}
+	}
+
+	return NULL;
+}
+
+static bool sqc_coalesce(MQTTClient client, const char *topic, int length, const void *payload, int retained, int *rc){
+/* Coalesce a message if needed
+ * -> true if the message has been handled (published, delayed or ignored)
+ *  and rc set, false if it is not subject to coalescing
+ */
+	struct coalescerule *rule;
+	struct coalesced *e;
+
+	pthread_mutex_lock(&coalescer.mutex);
+
+	for(rule = coalescer.rules; rule; rule = rule->next)
+		if(!sqc_mqtttokcmp(rule->filter, topic))
+			break;
+
+	if(!rule || !rule->window){	/* Not coalesced */
+		pthread_mutex_unlock(&coalescer.mutex);
+		return false;
+	}
+
+		/* Looks for this topic */
+	unsigned int h = selL_hash(topic);
+	struct coalesced **bucket = &coalescer.buckets[h % COALESCE_BUCKETS];
+
+	for(e = *bucket; e; e = e->next)
+		if(e->H == h && e->client == client && !strcmp(e->topic, topic))
+			break;
+
+	if(!e){	/* New one */
+		assert( (e = calloc(1, sizeof(struct coalesced))) );
+		assert( (e->topic = strdup(topic)) );
+		e->client = client;
+		e->H = h;
+		e->next = *bucket;
+		*bucket = e;
+
+		if(!coalescer.topics++)	/* The flusher has to schedule reclaiming */
+			pthread_cond_signal(&coalescer.cond);
+	}
+	e->rule = rule;
+
+	unsigned long long int now = sqc_now();
+
+	if(!e->pending){
+		if(rule->onlychanged && sqc_samebuf(&e->sent, payload, length, retained)){
+			coalescer.unchanged++;
+			pthread_mutex_unlock(&coalescer.mutex);
+			*rc = MQTTCLIENT_SUCCESS;
+			return true;
+		}
+
+		if(!e->sent.data || now >= e->lastsent + rule->window){	/* Window is over : publish now */
+			if((*rc = sqc_publishnow(client, topic, length, payload, retained)) == MQTTCLIENT_SUCCESS){
+				sqc_setbuf(&e->sent, payload, length, retained);
+				e->lastsent = now;
+			}
+			pthread_mutex_unlock(&coalescer.mutex);
+			return true;
+		}
+
+			/* Wait for the end of the window */
+		e->pending = true;
+		e->pnext = coalescer.pending;
+		coalescer.pending = e;
+		pthread_cond_signal(&coalescer.cond);
+	} else
+		coalescer.coalesced++;
+
+	sqc_setbuf(&e->value, payload, length, retained);	/* Keep the latest value */
+
+	pthread_mutex_unlock(&coalescer.mutex);
+	*rc = MQTTCLIENT_SUCCESS;
+	return true;
+}
+
+static bool sqc_coalescePublish(const char *filter, unsigned long int window, bool onlychanged){
+/**
+ * @brief Coalesce messages published to topics matching a filter
+ *
+ * Rules are checked in declaration order, the first matching one is
+ * applied. Updating a filter changes its rule.
+ *
+ * @function coalescePublish
+ * @tparam const char * filter topic filter (MQTT wildcards allowed)
+ * @tparam unsigned long int window in milliseconds (0 : not coalesced)
+ * @tparam bool onlychanged don't publish a value identical to the last published one
+ * @treturn boolean false if the flushing thread can't be created
+ */
+	struct coalescerule *rule;
+
+	pthread_mutex_lock(&coalescer.mutex);
+
+	if(!coalescer.running){	/* Launch the flusher */
+		pthread_condattr_t attr;
+		pthread_t tid;
+
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&coalescer.cond, &attr);
+		pthread_condattr_destroy(&attr);
+
+		if(pthread_create(&tid, NULL, sqc_flusher, NULL)){
+			pthread_mutex_unlock(&coalescer.mutex);
+			selLog->Log('E', "Can't create MQTT coalescing thread");
+			return false;
+		}
+		pthread_detach(tid);
+		coalescer.running = true;
+	}
+
+	for(rule = coalescer.rules; rule; rule = rule->next)
+		if(!strcmp(rule->filter, filter))
+			break;
+
+	if(!rule){	/* New rule */
+		assert( (rule = malloc(sizeof(struct coalescerule))) );
+		assert( (rule->filter = strdup(filter)) );
+		rule->next = NULL;
+
+		if(coalescer.lastrule)
+			coalescer.lastrule->next = rule;
+		else
+			coalescer.rules = rule;
+		coalescer.lastrule = rule;
+	}
+	rule->window = window;
+	rule->onlychanged = onlychanged;
+
+	atomic_store(&coalescing, true);
+	pthread_cond_signal(&coalescer.cond);	/* Deadlines may have changed */
+	pthread_mutex_unlock(&coalescer.mutex);
+
+	return true;
+}
+
+static int sqc_mqttpublish(MQTTClient client, const char *topic, int length, void *payload, int retained){
+/**
+ * @brief Publish a message to a given topic.
+ *
+ * If the topic is subject to coalescing, the message may be delayed
+ * or ignored.
+ *
+ * @function mqttpublish
+ * @tparam MQTTClient MQTT client handle
+ * @tparam string Topic to publish to
+ * @tparam int payload length
+ * @tparam void * payload to publish
+ * @tparam int true if the document is retained
+ * @return result of the publishing (see MQTTClient_publishMessage)
+ */
+	int rc;
+
+	if(atomic_load(&coalescing) && sqc_coalesce(client, topic, length, payload, retained, &rc))
+		return rc;
+
+	return sqc_publishnow(client, topic, length, payload, retained);
+}
+
 static const struct ConstTranscode _QoS[] = {
 	{ "QoS0", 0 },
 	{ "QoS1", 1 },
@@ -214,15 +1168,298 @@ static int sql_publish(lua_State *L){
 	return 0;
 }
 
+static int sql_publishbatch(lua_State *L){
+/**
+ * @brief Publish several messages at once
+ *
+ * Messages are queued and published by a background thread : this method
+ * doesn't wait for the network.
+ *
+ * @function PublishBatch
+ * @tparam table messages array of @{PublishBatch_message}
+ * @tparam table options @{PublishBatch_options} (optional)
+ * @treturn integer number of queued messages (others are dropped as the queue is full)
+ * @usage
+client:PublishBatch({
+	{ topic="home/temperature", payload=21.5 },
+	{ topic="home/humidity", payload=45, retain=true, qos=1 }
+}, { trigger=delivered })
+ */
+/**
+ *	Message for @{PublishBatch}
+ *
+ *	@table PublishBatch_message
+ *	@field topic topic to publish to
+ *	@field payload value to publish
+ *	@field retain true if the message is retained
+ *	@field qos QoS of the message (default 0)
+ */
+/**
+ *	Options for @{PublishBatch}
+ *
+ *	@table PublishBatch_options
+ *	@field trigger function to be added in the todo list when all messages are delivered (main thread only)
+ *	@field trigger_once if true (default), the function is only added if not already in the todo list
+ */
+	struct enhanced_client *eclient = checkSelMQTT(L);
+	int trigger = LUA_REFNIL;
+	enum TaskOnce trigger_once = TO_ONCE;
+	unsigned int nbre, i;
+
+	if(!eclient){
+		lua_pushnil(L);
+		lua_pushstring(L, "PublishBatch() to a dead object");
+		return 2;
+	}
+
+	luaL_checktype(L, 2, LUA_TTABLE);
+
+	if(lua_istable(L, 3)){
+		lua_pushstring(L, "trigger");
+		lua_gettable(L, 3);
+		if(lua_type(L, -1) == LUA_TFUNCTION && selScripting)
+			trigger = selScripting->findFuncRef(L, lua_gettop(L));
+		lua_pop(L, 1);
+
+		lua_pushstring(L, "trigger_once");
+		lua_gettable(L, 3);
+		if(lua_type(L, -1) == LUA_TBOOLEAN)
+			trigger_once = lua_toboolean(L, -1) ? TO_ONCE : TO_MULTIPLE;
+		else if(lua_type(L, -1) == LUA_TNUMBER)
+			trigger_once = lua_tointeger(L, -1);
+		lua_pop(L, 1);
+	}
+
+#if LUA_VERSION_NUM > 501
+	nbre = lua_rawlen(L, 2);
+#else
+	nbre = lua_objlen(L, 2);
+#endif
+	if(!nbre){
+		lua_pushinteger(L, 0);
+		return 1;
+	}
+
+		/* Strings are kept on the stack until messages are queued */
+	luaL_checkstack(L, nbre * 2, "too many messages");
+	struct SelMQTTMessage *msgs = malloc(sizeof(struct SelMQTTMessage) * nbre);
+	assert(msgs);
+
+	for(i = 0; i < nbre; i++){
+		size_t len;
+
+		lua_rawgeti(L, 2, i + 1);
+		if(!lua_istable(L, -1)){
+			free(msgs);
+			return luaL_error(L, "PublishBatch() : message %d is not a table", i + 1);
+		}
+
+		lua_pushstring(L, "topic");
+		lua_gettable(L, -2);
+		if(!(msgs[i].topic = lua_tostring(L, -1))){
+			free(msgs);
+			return luaL_error(L, "PublishBatch() : message %d without topic", i + 1);
+		}
+		lua_insert(L, -2);	/* Keep the topic */
+
+		lua_pushstring(L, "payload");
+		lua_gettable(L, -2);
+		if(!(msgs[i].payload = lua_tolstring(L, -1, &len))){
+			free(msgs);
+			return luaL_error(L, "PublishBatch() : message %d without payload", i + 1);
+		}
+		msgs[i].length = len;
+		lua_insert(L, -2);	/* Keep the payload */
+
+		lua_pushstring(L, "retain");
+		lua_gettable(L, -2);
+		msgs[i].retained = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+
+		lua_pushstring(L, "qos");
+		lua_gettable(L, -2);
+		msgs[i].qos = lua_tointeger(L, -1);
+		lua_pop(L, 1);
+
+		lua_pop(L, 1);	/* the message */
+	}
+
+	lua_pushinteger(L, selMQTT.mqttpublishv(eclient->client, msgs, nbre, trigger, trigger_once));
+	free(msgs);
+
+	return 1;
+}
+
+static int sql_configurePublisher(lua_State *L){
+/**
+ * @brief Configure the background publisher used by @{PublishBatch}
+ *
+ * @function ConfigurePublisher
+ * @tparam table ConfigurePublisher_arguments
+ * @usage
+SelMQTT.ConfigurePublisher{ queue=10000, window=64 }
+ */
+/**
+ * Arguments for @{ConfigurePublisher}
+ *
+ * Missing fields keep their current value.
+ *
+ * @table ConfigurePublisher_arguments
+ * @field queue maximum number of pending messages, 0 for unlimited (default 4096)
+ * @field window maximum number of QoS 1/2 messages waiting for their acknowledgement (default 32)
+ */
+	if(!lua_istable(L, 1)){
+		lua_pushnil(L);
+		lua_pushstring(L, "SelMQTT.ConfigurePublisher() is expecting a table");
+		return 2;
+	}
+
+	pthread_mutex_lock(&publisher.mutex);
+	lua_Integer queue = publisher.maxqueue, window = publisher.window;
+	pthread_mutex_unlock(&publisher.mutex);
+
+	lua_pushstring(L, "queue");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		queue = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "window");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		window = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	if(queue < 0 || window <= 0 || !sqc_configurePublisher(queue, window)){
+		lua_pushnil(L);
+		lua_pushstring(L, "SelMQTT.ConfigurePublisher() : invalid arguments");
+		return 2;
+	}
+
+	lua_pushboolean(L, true);
+	return 1;
+}
+
+static int sql_coalesce(lua_State *L){
+/**
+ * @brief Coalesce messages published to some topics
+ *
+ * Messages published with @{Publish} to matching topics are rate limited :
+ * at most one message is sent per window, only the latest value being kept.
+ * Scripts don't have to be changed.
+ * Messages sent by @{PublishBatch} and SelLog are not coalesced.
+ *
+ * @function Coalesce
+ * @tparam table Coalesce_arguments
+ * @usage
+SelMQTT.Coalesce{ topic="sensors/#", window=1, only_changed=true }
+ */
+/**
+ * Arguments for @{Coalesce}
+ *
+ * @table Coalesce_arguments
+ * @field topic topic filter (MQTT wildcards allowed). Rules are checked in declaration order.
+ * @field window in seconds (0 : messages are not coalesced anymore)
+ * @field only_changed if true, a value identical to the last published one is ignored (topics not published for a minute after their window are forgotten : their next value is always sent)
+ */
+	if(!lua_istable(L, 1)){
+		lua_pushnil(L);
+		lua_pushstring(L, "SelMQTT.Coalesce() is expecting a table");
+		return 2;
+	}
+
+	lua_pushstring(L, "topic");
+	lua_gettable(L, 1);
+	const char *topic = lua_tostring(L, -1);
+	lua_pop(L, 1);	/* The string is still referenced by the table */
+
+	lua_pushstring(L, "window");
+	lua_gettable(L, 1);
+	lua_Number window = lua_tonumber(L, -1);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "only_changed");
+	lua_gettable(L, 1);
+	bool onlychanged = lua_toboolean(L, -1);
+	lua_pop(L, 1);
+
+	if(!topic || window < 0){
+		lua_pushnil(L);
+		lua_pushstring(L, "SelMQTT.Coalesce() : invalid arguments");
+		return 2;
+	}
+
+	if(!sqc_coalescePublish(topic, window * 1000, onlychanged)){
+		lua_pushnil(L);
+		lua_pushstring(L, "SelMQTT.Coalesce() : can't create the flushing thread");
+		return 2;
+	}
+
+	lua_pushboolean(L, true);
+	return 1;
+}
+
+static int sql_publisherStats(lua_State *L){
+/**
+ * @brief Background publisher statistics
+ *
+ * @function PublisherStats
+ * @treturn table with **queued**, **peak_queued**, **inflight**, **peak_inflight**, **published**, **delivered**, **failed**, **dropped** and **bytes** fields.
+ * **coalesced**, **unchanged** and **flushed** are related to @{Coalesce}.
+ */
+	pthread_mutex_lock(&publisher.mutex);
+	unsigned int queued = publisher.queued, peakqueue = publisher.peakqueue;
+	unsigned int inflight = publisher.ninflight, peakinflight = publisher.peakinflight;
+	unsigned long int published = publisher.published, delivered = publisher.delivered;
+	unsigned long int failed = publisher.failed, dropped = publisher.dropped;
+	unsigned long long int bytes = publisher.bytes;
+	pthread_mutex_unlock(&publisher.mutex);
+
+	pthread_mutex_lock(&coalescer.mutex);
+	unsigned long int coalesced = coalescer.coalesced, unchanged = coalescer.unchanged, flushed = coalescer.flushed;
+	pthread_mutex_unlock(&coalescer.mutex);
+
+	lua_newtable(L);
+
+	lua_pushinteger(L, queued);
+	lua_setfield(L, -2, "queued");
+	lua_pushinteger(L, peakqueue);
+	lua_setfield(L, -2, "peak_queued");
+	lua_pushinteger(L, inflight);
+	lua_setfield(L, -2, "inflight");
+	lua_pushinteger(L, peakinflight);
+	lua_setfield(L, -2, "peak_inflight");
+	lua_pushinteger(L, published);
+	lua_setfield(L, -2, "published");
+	lua_pushinteger(L, delivered);
+	lua_setfield(L, -2, "delivered");
+	lua_pushinteger(L, failed);
+	lua_setfield(L, -2, "failed");
+	lua_pushinteger(L, dropped);
+	lua_setfield(L, -2, "dropped");
+	lua_pushinteger(L, bytes);
+	lua_setfield(L, -2, "bytes");
+	lua_pushinteger(L, coalesced);
+	lua_setfield(L, -2, "coalesced");
+	lua_pushinteger(L, unchanged);
+	lua_setfield(L, -2, "unchanged");
+	lua_pushinteger(L, flushed);
+	lua_setfield(L, -2, "flushed");
+
+	return 1;
+}
+
 static const struct luaL_Reg SelMQTTLib [] = {
 	{"QoSConst", sql_QoSConst},
 	{"ErrConst", sql_ErrCodeConst},
 	{"StrError", sql_StrError},
+	{"PublisherStats", sql_publisherStats},
 	{NULL, NULL}
 };
 
 static const struct luaL_Reg SelMQTTtM [] = {	/* Apply on all threads */
 	{"Publish", sql_publish},
+	{"PublishBatch", sql_publishbatch},
 	{NULL, NULL}
 };
 
@@ -242,54 +1479,135 @@ static void sqc_connlost(void *actx, char *cause){
 		selScripting->pushtask( ctx->onDisconnectTrig, TO_MULTIPLE );
 }
 
+static void sqc_handlemsg(struct _topic *tp, void *a){
+/* Handle a message for a matching subscription */
+	struct mqttpayload *pl = a;
+
+	if(tp->worker)	/* Handled by its long-lived worker */
+		sqc_queuemsg(tp->worker, pl);
+	else if(tp->func){	/* Call back function defined */
+		lua_State *tstate = selMultitasking->createSlaveState();
+
+			/* Push arguments */
+		lua_pushstring(tstate, pl->topic);			/* 1: topic */
+		sqc_pushpayload(tstate, pl, tp->rawpayload);	/* 2: payload */
+		lua_pushboolean(tstate, pl->msg->retained);	/* 3: Retained */
+		lua_pushboolean(tstate, pl->msg->dup);		/* 4: duplicated message */
+
+		selMultitasking->loadandlaunch(NULL, tstate, tp->func, 4, 1, tp->trigger, tp->trigger_once);
+	} else {
+		/* No call back : set a shared variable
+		 * and unconditionally push a trigger if it exists
+		 */
+		selSharedVar->setStringL(pl->topic, pl->msg->payload, pl->msg->payloadlen, 0);
+		if(tp->trigger != LUA_REFNIL && selScripting)	/* Push trigger function if defined */
+			selScripting->pushtask(tp->trigger, tp->trigger_once);
+	}
+
+	if(tp->watchdog){
+		selLog->Log('D', "Resetting");
+		selTimer->reset(tp->watchdog); /* Reset the wathdog : data arrived on time */
+	}
+}
+
 static int sqc_msgarrived(void *actx, char *topic, int tlen, MQTTClient_message *msg){
 /* handle message arrival and call associated function.
- * NOTE : up to now, only textual topics & messages are
- * correctly handled (lengths are simply ignored)
+ * Payloads are binary safe, topics are expected to be NUL terminated.
+ * Paho's message is kept until its last consumer released it.
  */
 	struct enhanced_client *ctx = actx;	/* To avoid numerous cast */
-	struct _topic *tp;
-	char cpayload[msg->payloadlen + 1];
-	memcpy(cpayload, msg->payload, msg->payloadlen);
-	cpayload[msg->payloadlen] = 0;
 #ifdef DEBUG
 	selLog->Log('D', "topic : %s", topic);
 #endif
 
-	for(tp = ctx->subscriptions; tp; tp = tp->next){	/* Looks for the corresponding function */
+	struct mqttpayload *pl = malloc(sizeof(struct mqttpayload));
+	assert(pl);
+	atomic_init(&pl->refs, 1);
+	pl->topic = topic;
+	pl->msg = msg;
 
-		if(!sqc_mqtttokcmp(tp->topic, topic)){
-			if(tp->func){	/* Call back function defined */
-				lua_State *tstate = selMultitasking->createSlaveState();
+	if(ctx->trie)	/* Looks for the corresponding subscriptions */
+		sqc_triematch(ctx->trie, topic, sqc_handlemsg, pl);
 
-					/* Push arguments */
-				lua_pushstring(tstate, topic);			/* 1: topic */
-				lua_pushstring(tstate, cpayload);			/* 2: payload */
-				lua_pushboolean(tstate, msg->retained);	/* 3: Retained */
-				lua_pushboolean(tstate, msg->dup);		/* 4: duplicated message */
+	sqc_payloadrelease(pl);
+	return 1;
+}
 
-				selMultitasking->loadandlaunch(NULL, tstate, tp->func, 4, 1, tp->trigger, tp->trigger);
-			} else {
-				/* No call back : set a shared variable
-				 * and unconditionally push a trigger if it exists
-				 */
-				selSharedVar->setString(topic, cpayload, 0);
-				if(tp->trigger != LUA_REFNIL && selScripting)	/* Push trigger function if defined */
-					selScripting->pushtask(tp->trigger, tp->trigger_once);
-			}
+	/*
+	 * SelMQTTPayload : read-only access to a received payload
+	 */
 
-			if(tp->watchdog){
-				selLog->Log('D', "Resetting");
-				selTimer->reset(tp->watchdog); /* Reset the wathdog : data arrived on time */
-			}
-		}
-	}
+static struct mqttpayload *checkSelMQTTPayload(lua_State *L, int idx){
+	void *r = selLua->testudata(L, idx, "SelMQTTPayload");
+	luaL_argcheck(L, r != NULL, idx, "'SelMQTTPayload' expected");
+	return *(struct mqttpayload **)r;
+}
 
-	MQTTClient_freeMessage(&msg);
-	MQTTClient_free(topic);
+static const void *sqc_getPayload(lua_State *L, int idx, size_t *len){
+/**
+ * @brief Direct access to a SelMQTTPayload's content
+ *
+ * The buffer is valid as long as the object is alive.
+ *
+ * @function getPayload
+ * @tparam lua_State *L
+ * @tparam int idx index of the SelMQTTPayload object on the stack
+ * @tparam size_t *len payload's length
+ * @return payload (NULL if it's not a SelMQTTPayload)
+ */
+	void *r = selLua->testudata(L, idx, "SelMQTTPayload");
+	if(!r)
+		return NULL;
+
+	struct mqttpayload *pl = *(struct mqttpayload **)r;
+	if(len)
+		*len = pl->msg->payloadlen;
+	return pl->msg->payload;
+}
+
+static int sqpl_tostring(lua_State *L){
+/** 
+ * @brief Payload as a string
+ *
+ * @function String
+ * @treturn string
+ */
+	struct mqttpayload *pl = checkSelMQTTPayload(L, 1);
+	lua_pushlstring(L, pl->msg->payload, pl->msg->payloadlen);
+	return 1;
+}
+
+static int sqpl_len(lua_State *L){
+/** 
+ * @brief Payload's length
+ *
+ * @function Length
+ * @treturn integer
+ */
+	struct mqttpayload *pl = checkSelMQTTPayload(L, 1);
+	lua_pushinteger(L, pl->msg->payloadlen);
 	return 1;
 }
 
+static int sqpl_gc(lua_State *L){
+	struct mqttpayload **r = (struct mqttpayload **)selLua->testudata(L, 1, "SelMQTTPayload");
+
+	if(r && *r){
+		sqc_payloadrelease(*r);
+		*r = NULL;
+	}
+	return 0;
+}
+
+static const struct luaL_Reg SelMQTTPayloadM [] = {
+	{"String", sqpl_tostring},
+	{"Length", sqpl_len},
+	{"__tostring", sqpl_tostring},
+	{"__len", sqpl_len},
+	{"__gc", sqpl_gc},
+	{NULL, NULL}
+};
+
 static int sql_connect(lua_State *L){
 /** Connect to a broker
  *
@@ -446,6 +1764,7 @@ static int sql_connect(lua_State *L){
 	luaL_getmetatable(L, "SelMQTT");
 	lua_setmetatable(L, -2);
 	eclient->subscriptions = NULL;
+	eclient->trie = NULL;
 	eclient->onDisconnectFunc = onDisconnectFunc;
 	eclient->onDisconnectTrig = OnDisconnectTrig;
 
@@ -454,7 +1773,7 @@ static int sql_connect(lua_State *L){
 	if((nerr = MQTTClient_create( &(eclient->client), host, clientID, persistence ? MQTTCLIENT_PERSISTENCE_DEFAULT : MQTTCLIENT_PERSISTENCE_NONE, (void *)persistence )) != MQTTCLIENT_SUCCESS)
 		err = "Fail to create";
 	else {
-		if((nerr = MQTTClient_setCallbacks( eclient->client, eclient, sqc_connlost, sqc_msgarrived, NULL)) != MQTTCLIENT_SUCCESS)
+		if((nerr = MQTTClient_setCallbacks( eclient->client, eclient, sqc_connlost, sqc_msgarrived, sqc_delivered)) != MQTTCLIENT_SUCCESS)
 			err = "Fail to set Callbacks";
 		else switch( (nerr = MQTTClient_connect( eclient->client, &conn_opts)) ){
 			case MQTTCLIENT_SUCCESS : 
@@ -499,6 +1818,7 @@ void sqc_createExternallyManaged(lua_State *L, MQTTClient client){
 
 	eclient->client = client;
 	eclient->subscriptions = NULL;
+	eclient->trie = NULL;
 	eclient->onDisconnectFunc = NULL;
 	eclient->onDisconnectTrig = LUA_REFNIL;
 
@@ -507,6 +1827,8 @@ void sqc_createExternallyManaged(lua_State *L, MQTTClient client){
 
 static const struct luaL_Reg SelMQTTExtLib [] = {
 	{"Connect", sql_connect},
+	{"ConfigurePublisher", sql_configurePublisher},
+	{"Coalesce", sql_coalesce},
 	{NULL, NULL}
 };
 
@@ -524,6 +1846,9 @@ static int sql_subscribe(lua_State *L){
  *	@table Subscribe_arguments
  *	@field topic topic name to subscribe
  *	@field func function to call when a message arrive (run in a dedicated thread)
+ *	@field worker if true, **func** is run by a long-lived worker dedicated to this subscription : messages are handled in order and the function's globals survive between messages
+ *	@field worker_queue maximum number of messages waiting for the worker, the oldest ones are dropped beyond (default 1024, 0 : unlimited)
+ *	@field rawpayload if true, **func** receives a **SelMQTTPayload** object (read-only access to the received buffer, without copy) instead of a string
  *	@field trigger function to be added in the todo list
  *	@field trigger_once if true, the function is only added if not already in the todo list
  *	@field qos as the name said, default 0
@@ -564,6 +1889,9 @@ static int sql_subscribe(lua_State *L){
 		int trigger = LUA_REFNIL;
 		enum TaskOnce trigger_once = TO_ONCE;
 		struct selTimerStorage *watchdog = NULL;
+		bool worker = false;
+		lua_Integer worker_queue = 1024;
+		bool rawpayload = false;
 
 		lua_pushstring(L, "topic");
 		lua_gettable(L, -2);
@@ -626,6 +1954,25 @@ static int sql_subscribe(lua_State *L){
 		}
 		lua_pop(L, 1);	/* Pop the watchdog */
 
+		lua_pushstring(L, "worker");
+		lua_gettable(L, -2);
+		worker = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+
+		lua_pushstring(L, "worker_queue");
+		lua_gettable(L, -2);
+		if(lua_type(L, -1) == LUA_TNUMBER)
+			worker_queue = lua_tointeger(L, -1);
+		lua_pop(L, 1);
+
+		lua_pushstring(L, "rawpayload");
+		lua_gettable(L, -2);
+		rawpayload = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+
+		if(worker && !func)
+			return luaL_error(L, "A worker needs a function");
+
 			/* Allocating the new topic */
 		assert( (nt = malloc(sizeof(struct _topic))) );
 		nt->next = eclient->subscriptions;
@@ -635,7 +1982,12 @@ static int sql_subscribe(lua_State *L){
 		nt->func = func;
 		nt->trigger = trigger;
 		nt->trigger_once = trigger_once;
+		nt->rawpayload = rawpayload;
+		nt->worker = NULL;
+		if(worker && !(nt->worker = sqc_createworker(nt, worker_queue > 0 ? worker_queue : 0)))
+			return luaL_error(L, "Can't create the worker");
 		eclient->subscriptions = nt;
+		sqc_trieinsert(&eclient->trie, nt);
 
 		lua_pop(L, 1);	/* Pop the sub-table */
 	}
@@ -676,6 +2028,7 @@ static const struct luaL_Reg SelMQTTM [] = {
 static void registerSelMQTT(lua_State *L){
 	selLua->libCreateOrAddFuncs(L, "SelMQTT", SelMQTTLib);
 	selLua->objFuncs(L, "SelMQTT", SelMQTTtM);
+	selLua->objFuncs(L, "SelMQTTPayload", SelMQTTPayloadM);
 }
 
 
@@ -724,9 +2077,13 @@ bool InitModule( void ){
 	selMQTT.module.laterebuilddependancies = sqc_laterebuilddependancies;
 
 	selMQTT.mqttpublish = sqc_mqttpublish;
+	selMQTT.mqttpublishv = sqc_mqttpublishv;
+	selMQTT.configurePublisher = sqc_configurePublisher;
+	selMQTT.coalescePublish = sqc_coalescePublish;
 	selMQTT.mqtttokcmp = sqc_mqtttokcmp;
 	selMQTT.checkSelMQTT = checkSelMQTT;
 	selMQTT.createExternallyManaged = sqc_createExternallyManaged;
+	selMQTT.getPayload = sqc_getPayload;
 
 	registerModule((struct SelModule *)&selMQTT);
 
@@ -734,6 +2091,7 @@ bool InitModule( void ){
 	selLua->libCreateOrAddFuncs(NULL, "SelMQTT", SelMQTTExtLib);
 	selLua->objFuncs(NULL, "SelMQTT", SelMQTTtM);
 	selLua->objFuncs(NULL, "SelMQTT", SelMQTTM);
+	selLua->objFuncs(NULL, "SelMQTTPayload", SelMQTTPayloadM);
 
 	selLua->AddStartupFunc(registerSelMQTT);
 
@@ -2,6 +2,15 @@
  *
  * Detached tasks
  *
+ * Triggered functions (MQTT callbacks, ...) are run by an elastic pool of
+ * worker threads : at least minworkers are kept alive, up to maxworkers
+ * are created on demand, and jobs are queued when all of them are busy.
+ * Functions launched by Detach() may never end : they get their own
+ * thread, outside of the pool's limits.
+ *
+ * Slave states are kept warm in a pool as well, instead of being
+ * created and closed for each run.
+ *
  * 23/02/2024 First version
  */
 #include <Selene/SelMultitasking.h>
@@ -22,6 +31,7 @@ static struct SelElasticStorage *selElasticStorage;
 #include <assert.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
 
 pthread_attr_t thread_attr;
 
@@ -35,6 +45,7 @@ static bool smc_checkdependencies(){ /* Ensure all dependancies are met */
 	/* Arguments to be passed to the function to be launched */
 
 struct launchargs {
+	struct launchargs *next;	/* Next job in the queue */
 	lua_State *L;	/* New thread Lua state */
 	int nargs;		/* Number of arguments for the function */
 	int nresults;	/* Number of results */
@@ -42,10 +53,201 @@ struct launchargs {
 	enum TaskOnce trigger_once;
 };
 
-static void *launchfunc(void *a){
-/* Low level code the launch the detached function in a new thread 
+	/* ***
+	 * Workers pool
+	 * ***/
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;	/* Signaled when a job is queued */
+
+	struct launchargs *first, *last;	/* Pending jobs */
+	unsigned int queued;	/* Number of pending jobs */
+
+	unsigned int workers;	/* Running workers */
+	unsigned int idle;		/* Workers waiting for a job */
+
+		/* Configuration */
+	unsigned int minworkers;	/* Workers kept even if idle */
+	unsigned int maxworkers;	/* Maximum number of workers */
+	unsigned int maxqueue;		/* Maximum number of pending jobs (0 : unlimited) */
+	unsigned int idletimeout;	/* Seconds before an extra idle worker exits */
+
+		/* Statistics */
+	unsigned long int submitted;
+	unsigned long int completed;
+	unsigned long int rejected;
+	unsigned int peakqueue;
+	unsigned int peakworkers;
+} pool = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.minworkers = 2,
+	.maxworkers = 64,	/* Generous as detached functions may run for long */
+	.maxqueue = 1024,
+	.idletimeout = 30
+};
+
+	/* ***
+	 * Slave states pool
+	 *
+	 * Idle states are reused as long as they have been initialised
+	 * with the current startup functions' generation, and are recycled after
+	 * maxuses runs or maxage seconds to bound memory growth.
+	 * ***/
+
+struct slavestate {
+	struct slavestate *next;
+	lua_State *L;
+	unsigned int generation;	/* Startup functions' generation */
+	unsigned int uses;			/* Number of runs */
+	time_t created;
+	unsigned int cached;		/* Number of functions in the cache */
+};
+
+static char slavestatekey;	/* Registry key to retrieve slavestate from the Lua state */
+static char chunkcachekey;	/* Registry key of loaded functions cache */
+
+#define MAXCACHED 64	/* Loaded functions kept by a slave state */
+
+static struct {
+	pthread_mutex_t mutex;
+	struct slavestate *idle;	/* Available states */
+	unsigned int nidle;
+
+		/* Configuration */
+	unsigned int maxidle;	/* Maximum number of idle states kept (0 : no pooling) */
+	unsigned int maxuses;	/* Runs before recycling (0 : unlimited) */
+	unsigned int maxage;	/* Seconds before recycling (0 : unlimited) */
+
+		/* Statistics */
+	unsigned long int created;
+	unsigned long int reused;
+	unsigned long int recycled;
+} states = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.maxidle = 8,
+	.maxuses = 1000,
+	.maxage = 300
+};
+
+static struct slavestate *getslavestate(lua_State *L){
+	lua_pushlightuserdata(L, &slavestatekey);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	struct slavestate *st = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+
+	return st;
+}
+
+static void closeslavestate(struct slavestate *st){
+	lua_close(st->L);
+	free(st);
+}
+
+static void smc_releaseSlaveState(lua_State *L){
+/**
+ * Give back a slave state created by createSlaveState()
+ *
+ * It is reset and returned to the pool or closed if it has to be recycled.
+ *
+ * @function releaseSlaveState
+ * @tparam state L slave state
+ */
+	struct slavestate *st = getslavestate(L);
+
+	if(!st){	/* Not from the pool */
+		lua_close(L);
+		return;
+	}
+
+	lua_settop(L, 0);	/* Reset */
+	lua_gc(L, LUA_GCSTEP, 0);
+	st->uses++;
+
+	pthread_mutex_lock(&states.mutex);
+	if(states.nidle >= states.maxidle ||
+	  st->generation != selLua->getStartupGeneration() ||
+	  (states.maxuses && st->uses >= states.maxuses) ||
+	  (states.maxage && time(NULL) - st->created >= states.maxage)
+	){
+		states.recycled++;
+		pthread_mutex_unlock(&states.mutex);
+		closeslavestate(st);
+		return;
+	}
+
+	st->next = states.idle;
+	states.idle = st;
+	states.nidle++;
+	pthread_mutex_unlock(&states.mutex);
+}
+
+static void smc_configureStatesPool(unsigned int max, unsigned int uses, unsigned int age){
+/**
+ * Configure slave states' pool
+ *
+ * @function configureStatesPool
+ *
+ * @tparam integer max maximum number of idle states kept (0 : no pooling)
+ * @tparam integer uses number of runs before a state is recycled (0 : unlimited)
+ * @tparam integer age seconds before a state is recycled (0 : unlimited)
+ */
+	struct slavestate *extra = NULL;
+
+	pthread_mutex_lock(&states.mutex);
+	states.maxidle = max;
+	states.maxuses = uses;
+	states.maxage = age;
+
+	while(states.nidle > states.maxidle){	/* Too many idle states */
+		struct slavestate *st = states.idle;
+		states.idle = st->next;
+		states.nidle--;
+
+		st->next = extra;
+		extra = st;
+	}
+	pthread_mutex_unlock(&states.mutex);
+
+	while(extra){	/* Closed outside the lock */
+		struct slavestate *st = extra;
+		extra = st->next;
+		closeslavestate(st);
+	}
+}
+
+static void isolate(lua_State *L){
+/* Run the function on top of the stack with its own globals,
+ * falling back to the shared ones : a reused state doesn't keep
+ * globals of previous runs.
+ * _G points to the proxy as well, so _G.x = ... and rawset(_G, ...) stay
+ * local to the run. Only writes done by functions coming from the shared
+ * globals (i.e. defined by startup functions) still reach them.
+ */
+	lua_newtable(L);	/* Proxy */
+	lua_newtable(L);	/* its metatable */
+#if LUA_VERSION_NUM > 501
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	lua_setfield(L, -2, "__index");
+	lua_setmetatable(L, -2);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "_G");	/* The proxy has no __newindex : raw */
+
+#if LUA_VERSION_NUM > 501
+	if(!lua_setupvalue(L, -2, 1))	/* 1st upvalue is the global environment */
+		lua_pop(L, 1);
+#else
+	lua_setfenv(L, -2);
+#endif
+}
+
+static void launchfunc(struct launchargs *arg){
+/* Low level code the launch the detached function
  */
-	struct launchargs *arg = a;	/* To avoid further casting */
 
 	if(lua_pcall( arg->L, arg->nargs, arg->nresults, 0))
 		selLog->Log('E', "(launch) %s\n", lua_tostring(arg->L, -1));
@@ -56,25 +258,201 @@ static void *launchfunc(void *a){
 		}
 	}
 
-	lua_close(arg->L);	/* Remove the new state */
+	smc_releaseSlaveState(arg->L);	/* Give back the state */
 	free(arg);			/* free arguments */
+}
+
+static void *worker(void *unused){
+/* Worker thread : run queued jobs.
+ * Extra workers exit after being idle for idletimeout seconds.
+ */
+	pthread_mutex_lock(&pool.mutex);
+	for(;;){
+		while(!pool.first){
+			int err;
+
+			pool.idle++;
+			if(pool.workers > pool.minworkers){
+				struct timespec ts;
+				clock_gettime(CLOCK_REALTIME, &ts);
+				ts.tv_sec += pool.idletimeout;
+				err = pthread_cond_timedwait(&pool.cond, &pool.mutex, &ts);
+			} else
+				err = pthread_cond_wait(&pool.cond, &pool.mutex);
+			pool.idle--;
+
+			if(err == ETIMEDOUT && !pool.first && pool.workers > pool.minworkers){
+				pool.workers--;
+				pthread_mutex_unlock(&pool.mutex);
+				return NULL;
+			}
+		}
+
+		struct launchargs *arg = pool.first;
+		if(!(pool.first = arg->next))
+			pool.last = NULL;
+		pool.queued--;
+		pthread_mutex_unlock(&pool.mutex);
+
+		launchfunc(arg);
+
+		pthread_mutex_lock(&pool.mutex);
+		pool.completed++;
+	}
+}
+
+static bool spawnworker(void){
+/* Create a new worker.
+ * pool.mutex has to be held
+ */
+	pthread_t tid;	/* No need to be kept */
+	int err;
+
+	if((err = pthread_create( &tid, &thread_attr, worker, NULL))){
+		selLog->Log('E', "Can't create a new worker : %s", strerror(err));
+		return false;
+	}
+
+	if(++pool.workers > pool.peakworkers)
+		pool.peakworkers = pool.workers;
+	return true;
+}
+
+static void *dedicated(void *arg){
+/* Thread running a single Detach()ed function */
+	launchfunc(arg);
 	return NULL;
 }
 
+static const char *submit(struct launchargs *arg){
+/* Queue a job and wake up (or create) a worker.
+ * -> NULL if succeeded, the error message otherwise
+ */
+	const char *err = NULL;
+
+	pthread_mutex_lock(&pool.mutex);
+	if(pool.maxqueue && pool.queued >= pool.maxqueue){
+		pool.rejected++;
+		err = "Workers' queue is full";
+	} else {
+		if(pool.idle <= pool.queued && pool.workers < pool.maxworkers)	/* Nobody available */
+			spawnworker();
+
+		if(!pool.workers){
+			pool.rejected++;
+			err = "No worker available";
+		} else {
+			arg->next = NULL;
+			if(pool.last)
+				pool.last->next = arg;
+			else
+				pool.first = arg;
+			pool.last = arg;
+
+			if(++pool.queued > pool.peakqueue)
+				pool.peakqueue = pool.queued;
+			pool.submitted++;
+
+			pthread_cond_signal(&pool.cond);
+		}
+	}
+	pthread_mutex_unlock(&pool.mutex);
+
+	return err;
+}
+
+static bool smc_configureWorkers(unsigned int min, unsigned int max, unsigned int queue, unsigned int idle){
+/**
+ * Configure the workers pool
+ *
+ * @function configureWorkers
+ *
+ * @tparam integer min workers kept alive
+ * @tparam integer max maximum number of workers
+ * @tparam integer queue maximum number of pending jobs (0 : unlimited)
+ * @tparam integer idle seconds before an extra idle worker exits
+ *
+ * @treturn boolean false if arguments are invalid
+ */
+	if(!max || min > max)
+		return false;
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.minworkers = min;
+	pool.maxworkers = max;
+	pool.maxqueue = queue;
+	pool.idletimeout = idle;
+
+	while(pool.workers < pool.minworkers)
+		if(!spawnworker())
+			break;
+
+	pthread_cond_broadcast(&pool.cond);	/* Let idle workers consider new limits */
+	pthread_mutex_unlock(&pool.mutex);
+
+	return true;
+}
+
 static lua_State *smc_createSlaveState(void){
 /**
  * Create and initialize a new state for slave threads
  *
+ * A warm state is taken from the pool if available.
+ * It has to be given back with releaseSlaveState() (loadandlaunch() is
+ * doing it).
+ *
  * @function createSlaveState
  *
  * @return new Lua state
  */
+	unsigned int gen = selLua->getStartupGeneration();
+	struct slavestate *st, *outdated = NULL;
+
+	pthread_mutex_lock(&states.mutex);
+	while((st = states.idle)){
+		states.idle = st->next;
+		states.nidle--;
+
+		if(st->generation == gen)
+			break;
+
+		st->next = outdated;	/* Misses some startup functions */
+		outdated = st;
+		states.recycled++;
+	}
+	if(st)
+		states.reused++;
+	else
+		states.created++;
+	pthread_mutex_unlock(&states.mutex);
+
+	while(outdated){
+		struct slavestate *o = outdated;
+		outdated = o->next;
+		closeslavestate(o);
+	}
+
+	if(st)
+		return st->L;
+
+	st = malloc(sizeof(struct slavestate));
+	assert(st);
+	st->generation = gen;
+	st->uses = 0;
+	st->created = time(NULL);
+	st->cached = 0;
+
 	lua_State *tstate = luaL_newstate();
 	assert(tstate);
 	luaL_openlibs( tstate );
 
 	selLua->ApplyStartupFunc(tstate);
 
+	lua_pushlightuserdata(tstate, &slavestatekey);
+	lua_pushlightuserdata(tstate, st);
+	lua_rawset(tstate, LUA_REGISTRYINDEX);
+	st->L = tstate;
+
 	return tstate;
 }
 
@@ -116,59 +494,136 @@ static int loadsharedfunction(lua_State *L, struct elastic_storage *func){
 	);
 }
 
-bool smc_loadandlaunch( lua_State *L, lua_State *newL, struct elastic_storage *storage, int nargs, int nresults, int trigger, enum TaskOnce trigger_once){
-/**
- * load and then launch a stored function in a slave thread
- *
- * @function loadandlaunch
- *
- * @tparam state L master thread (for error reporting, may be NULL)
- * @tparam state newL slave thread
- * @tparam elastic_storage storage the function stored
- * @tparam integer nargs number of arguments to the functions
- * @tparam integer trigger if not LUA_REFNIL, push this trigger_id in the todo list
- * @tparam TaskOnce trigger_once
+static int loadcachedfunction(lua_State *L, struct elastic_storage *func, bool oneshot){
+/* Load a stored function, reusing an already loaded one if the slave state
+ * is a pooled one : the cache is indexed by storage's generation, which
+ * is unique and changes with storage's content.
+ * One-shot storages (like Detach()'s ones) are never cached : they
+ * would only fill the cache up with entries that can't be hit.
  *
- * @treturn boolean succeeded or not
+ * Upvalues of a reused function are reset to nil as lua_load() does,
+ * so every run starts with fresh ones whatever the state picking up
+ * the job. The environment (1st upvalue since 5.2) is set by isolate().
  */
+	struct slavestate *st = getslavestate(L);
+	if(!st || oneshot)
+		return loadsharedfunction(L, func);
+
+	lua_pushlightuserdata(L, &chunkcachekey);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	if(!lua_istable(L, -1) || st->cached >= MAXCACHED){	/* (re)create the cache */
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushlightuserdata(L, &chunkcachekey);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+		st->cached = 0;
+	}
 
-		/* It's needed because this structure has to survive until
-		 * slave function is over.
-		 * It will be cleared in launchfunc()
-		 */
-	struct launchargs *arg = malloc( sizeof(struct launchargs) );
-	assert(arg);
-	arg->L = newL;
-	arg->nargs = nargs;
-	arg->nresults = nresults;
-	arg->triggerid = trigger;
+	lua_rawgeti(L, -1, func->generation);
+	if(lua_isfunction(L, -1)){	/* Already loaded */
+		lua_remove(L, -2);	/* remove the cache */
 
+		for(int i = (LUA_VERSION_NUM > 501) ? 2 : 1;; i++){
+			lua_pushnil(L);
+			if(!lua_setupvalue(L, -2, i)){	/* No more upvalue */
+				lua_pop(L, 1);
+				break;
+			}
+		}
+		return 0;
+	}
+	lua_pop(L, 1);
+
+	int err;
+	if((err = loadsharedfunction(L, func))){
+		lua_remove(L, -2);
+		return err;
+	}
+
+	lua_pushvalue(L, -1);
+	lua_rawseti(L, -3, func->generation);
+	st->cached++;
+	lua_remove(L, -2);
+
+	return 0;
+}
+
+static bool launch( lua_State *L, lua_State *newL, struct elastic_storage *storage, int nargs, int nresults, int trigger, enum TaskOnce trigger_once, bool own){
+/* loadandlaunch()'s implementation.
+ * If own is set, the function gets its own thread instead of being queued
+ * in the workers pool, and its storage is a one-shot one (not cached).
+ */
 	int err;
-	if((err = loadsharedfunction(newL, storage))){
+	if((err = loadcachedfunction(newL, storage, own))){
 		if(L){
 			lua_pushnil(L);
 			lua_pushstring(L, (err == LUA_ERRSYNTAX) ? "Syntax error" : "Memory error");
 		} else
 			selLog->Log('E', "Can't create a new thread : %s", (err == LUA_ERRSYNTAX) ? "Syntax error" : "Memory error" );
+		smc_releaseSlaveState(newL);
 		return false;
 	}
+	isolate(newL);
 
 	if(nargs)	/* Move the function before its arguments */
 		lua_insert(newL, -1 - nargs);
 
-	pthread_t tid;	/* No need to be kept */
-	if(pthread_create( &tid, &thread_attr, launchfunc,  arg)){
-		selLog->Log('E', "Can't create a new thread : %s", strerror(errno));
+		/* It's needed because this structure has to survive until
+		 * slave function is over.
+		 * It will be cleared in launchfunc()
+		 */
+	struct launchargs *arg = malloc( sizeof(struct launchargs) );
+	assert(arg);
+	arg->L = newL;
+	arg->nargs = nargs;
+	arg->nresults = nresults;
+	arg->triggerid = trigger;
+	arg->trigger_once = trigger_once;
+
+	const char *msg = NULL;
+	if(own){
+		pthread_t tid;	/* No need to be kept */
+		if((err = pthread_create(&tid, &thread_attr, dedicated, arg)))
+			msg = strerror(err);
+	} else
+		msg = submit(arg);
+
+	if(msg){
+		selLog->Log('E', "Can't launch a detached function : %s", msg);
 		if(L){
 			lua_pushnil(L);
-			lua_pushstring(L, strerror(errno));
+			lua_pushstring(L, msg);
 		}
+		smc_releaseSlaveState(newL);
+		free(arg);
 		return false;
 	}
 
 	return true;
 }
 
+bool smc_loadandlaunch( lua_State *L, lua_State *newL, struct elastic_storage *storage, int nargs, int nresults, int trigger, enum TaskOnce trigger_once){
+/**
+ * load and then launch a stored function in a slave thread
+ *
+ * @function loadandlaunch
+ *
+ * The function is queued in the workers pool.
+ * newL is owned by loadandlaunch() : it is released in any case.
+ *
+ * @tparam state L master thread (for error reporting, may be NULL)
+ * @tparam state newL slave thread
+ * @tparam elastic_storage storage the function stored
+ * @tparam integer nargs number of arguments to the functions
+ * @tparam integer trigger if not LUA_REFNIL, push this trigger_id in the todo list
+ * @tparam TaskOnce trigger_once
+ *
+ * @treturn boolean succeeded or not
+ */
+	return launch(L, newL, storage, nargs, nresults, trigger, trigger_once, false);
+}
+
 static bool smc_newthreadfunc(lua_State *L, struct elastic_storage *storage){
 /**
  * Launch a function in a new thread
@@ -181,7 +636,7 @@ static bool smc_newthreadfunc(lua_State *L, struct elastic_storage *storage){
  * @treturn boolean succeeded or not
  */
 	lua_State *tstate = selMultitasking.createSlaveState();
-	return(selMultitasking.loadandlaunch(L, tstate, storage, 0, 0, LUA_REFNIL, TO_MULTIPLE));
+	return(launch(L, tstate, storage, 0, 0, LUA_REFNIL, TO_MULTIPLE, true));	/* May never end : not in the pool */
 }
 
 static int smc_dumpwriter(lua_State *L, const void *b, size_t size, void *s){
@@ -234,8 +689,159 @@ static int sml_Detach( lua_State *L ){
 	return 0;
 }
 
+static int sml_ConfigureWorkers( lua_State *L ){
+/**
+ * Configure detached functions' workers pool
+ *
+ * @function ConfigureWorkers
+ * @tparam table ConfigureWorkers_arguments
+ * @see ConfigureWorkers_arguments
+ * @usage
+Selene.ConfigureWorkers{ min=4, max=32 }
+ */
+/**
+ * Arguments for @{ConfigureWorkers}
+ *
+ * Missing fields keep their current value.
+ *
+ * @table ConfigureWorkers_arguments
+ * @field min number of workers kept alive (default 2)
+ * @field max maximum number of workers (default 64)
+ * @field queue maximum number of pending functions, 0 for unlimited (default 1024)
+ * @field idle seconds before an extra idle worker exits (default 30)
+ * @field states maximum number of idle slave states kept warm, 0 to disable pooling (default 8)
+ * @field state_uses number of runs before a slave state is recycled, 0 for unlimited (default 1000)
+ * @field state_age seconds before a slave state is recycled, 0 for unlimited (default 300)
+ */
+	if(!lua_istable(L, 1)){
+		lua_pushnil(L);
+		lua_pushstring(L, "Selene.ConfigureWorkers() is expecting a table");
+		return 2;
+	}
+
+	pthread_mutex_lock(&pool.mutex);
+	lua_Integer min = pool.minworkers, max = pool.maxworkers, queue = pool.maxqueue, idle = pool.idletimeout;
+	pthread_mutex_unlock(&pool.mutex);
+
+	lua_pushstring(L, "min");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		min = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "max");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		max = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "queue");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		queue = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "idle");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		idle = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	if(min < 0 || max < 0 || queue < 0 || idle < 0 || !selMultitasking.configureWorkers(min, max, queue, idle)){
+		lua_pushnil(L);
+		lua_pushstring(L, "Invalid workers pool configuration");
+		return 2;
+	}
+
+	pthread_mutex_lock(&states.mutex);
+	lua_Integer smax = states.maxidle, suses = states.maxuses, sage = states.maxage;
+	pthread_mutex_unlock(&states.mutex);
+
+	lua_pushstring(L, "states");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		smax = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "state_uses");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		suses = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "state_age");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER)
+		sage = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	if(smax < 0 || suses < 0 || sage < 0){
+		lua_pushnil(L);
+		lua_pushstring(L, "Invalid states pool configuration");
+		return 2;
+	}
+	selMultitasking.configureStatesPool(smax, suses, sage);
+
+	return 0;
+}
+
+static int sml_WorkersStats( lua_State *L ){
+/**
+ * Workers pool statistics
+ *
+ * @function WorkersStats
+ * @treturn table with **workers**, **idle**, **peak_workers**, **queued**, **peak_queued**, **submitted**, **completed** and **rejected** fields.
+ * **states_idle**, **states_created**, **states_reused** and **states_recycled** are related to slave states pool.
+ */
+	pthread_mutex_lock(&pool.mutex);
+	unsigned int workers = pool.workers, idle = pool.idle, peakworkers = pool.peakworkers;
+	unsigned int queued = pool.queued, peakqueue = pool.peakqueue;
+	unsigned long int submitted = pool.submitted, completed = pool.completed, rejected = pool.rejected;
+	pthread_mutex_unlock(&pool.mutex);
+
+	pthread_mutex_lock(&states.mutex);
+	unsigned int sidle = states.nidle;
+	unsigned long int screated = states.created, sreused = states.reused, srecycled = states.recycled;
+	pthread_mutex_unlock(&states.mutex);
+
+	lua_newtable(L);
+
+	lua_pushinteger(L, workers);
+	lua_setfield(L, -2, "workers");
+	lua_pushinteger(L, idle);
+	lua_setfield(L, -2, "idle");
+	lua_pushinteger(L, peakworkers);
+	lua_setfield(L, -2, "peak_workers");
+	lua_pushinteger(L, queued);
+	lua_setfield(L, -2, "queued");
+	lua_pushinteger(L, peakqueue);
+	lua_setfield(L, -2, "peak_queued");
+	lua_pushinteger(L, submitted);
+	lua_setfield(L, -2, "submitted");
+	lua_pushinteger(L, completed);
+	lua_setfield(L, -2, "completed");
+	lua_pushinteger(L, rejected);
+	lua_setfield(L, -2, "rejected");
+	lua_pushinteger(L, sidle);
+	lua_setfield(L, -2, "states_idle");
+	lua_pushinteger(L, screated);
+	lua_setfield(L, -2, "states_created");
+	lua_pushinteger(L, sreused);
+	lua_setfield(L, -2, "states_reused");
+	lua_pushinteger(L, srecycled);
+	lua_setfield(L, -2, "states_recycled");
+
+	return 1;
+}
+
 static const struct luaL_Reg MultitaskLib[] = {
 	{"Detach", sml_Detach},
+	{"WorkersStats", sml_WorkersStats},
+	{NULL, NULL} /* End of definition */
+};
+
+static const struct luaL_Reg MultitaskMainLib[] = {	/* Main thread only */
+	{"ConfigureWorkers", sml_ConfigureWorkers},
 	{NULL, NULL} /* End of definition */
 };
 
@@ -276,12 +882,22 @@ bool InitModule( void ){
 	selMultitasking.loadandlaunch = smc_loadandlaunch;
 	selMultitasking.newthreadfunc = smc_newthreadfunc;
 	selMultitasking.dumpwriter = smc_dumpwriter;
+	selMultitasking.configureWorkers = smc_configureWorkers;
+	selMultitasking.releaseSlaveState = smc_releaseSlaveState;
+	selMultitasking.configureStatesPool = smc_configureStatesPool;
 
 	registerModule((struct SelModule *)&selMultitasking);
 
 	assert(!pthread_attr_init (&thread_attr));
 	assert(!pthread_attr_setdetachstate (&thread_attr, PTHREAD_CREATE_DETACHED));
 
+		/* Start minimal workers */
+	pthread_mutex_lock(&pool.mutex);
+	while(pool.workers < pool.minworkers)
+		if(!spawnworker())
+			break;
+	pthread_mutex_unlock(&pool.mutex);
+
 		/* Some piece of code only when running inside Selene.
 		 * Add some methods to main thread's Selene 
 		 */
@@ -291,6 +907,7 @@ bool InitModule( void ){
 		if(!selElasticStorage)
 			return false;
 		selLua->libCreateOrAddFuncs(NULL, "Selene", MultitaskLib);
+		selLua->libCreateOrAddFuncs(NULL, "Selene", MultitaskMainLib);
 		selLua->AddStartupFunc(registerMultitask);
 	}
 
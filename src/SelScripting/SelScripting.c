@@ -22,7 +22,8 @@
 #include <time.h>
 #include <unistd.h>
 #include <signal.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <assert.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
@@ -108,11 +109,8 @@ static int ssc_getToDoListFD(void){
 	 * Signal handling
 	 */
 
-static int sigfunc = LUA_REFNIL;	/* Function to call in case of SIG_INT */
-
 static void sighandler(int){
-	if(sigfunc != LUA_REFNIL)
-		ssc_pushtask(sigfunc, true);
+	ssc_raiseSignalTask();	/* Only async-signal-safe calls here */
 }
 
 static int ssl_SigIntTask(lua_State *L){
@@ -123,7 +121,7 @@ static int ssl_SigIntTask(lua_State *L){
  * @tparam function Function to be scheduled when a signal is received
  */
 	if( lua_type(L, -1) == LUA_TFUNCTION ){
-		sigfunc = ssc_findFuncRef(L,lua_gettop(L));
+		ssc_setSignalTask(ssc_findFuncRef(L,lua_gettop(L)));
 
 		signal(SIGINT, sighandler);
 		signal(SIGUSR1, sighandler);
@@ -131,54 +129,114 @@ static int ssl_SigIntTask(lua_State *L){
 	return 0;
 }
 
-static int ssl_WaitFor(lua_State *L){
-/** 
- * @brief Wait for even to come or a task is scheduled.
- *
- *	The process is put on hold and doesn't consume any processor resources until waked up.
- *  Have a look on *Selenites* examples directory : this function is the **most important one**
- * to achieve resources conservatives automation with Séléné.
- * But take also in account 
- *  - your tasks will be executed ONLY if there is a WaitFor() loop
- *  - It's not multitasking at all. Consequently, tasks are expected to be
- *  as fast as possible and definitively not blocking.
- *
- * @function WaitFor
- * @param ... list of **SelTimer**, **SelEvent**, file IO.
- * @return number of events to proceed, a SelError in case of error
+	/*
+	 * WaitFor() event set
+	 *
+	 * Supervised objects are registered once in a persistent epoll set, and
+	 * ready ones are retrieved directly from epoll_data.
+	 * The set is kept as long as WaitFor() is called with the same
+	 * arguments (which are referenced to keep them alive), and rebuilt
+	 * otherwise.
+	 * Regular files can't be registered in epoll (EPERM) : as with poll(),
+	 * they are considered as always readable.
+	 */
+
+enum WaitKind {
+	WK_TODO = 0,	/* Todo list's eventfd */
+	WK_FILE,
+	WK_TIMER,
+	WK_EVENT
+};
+
+struct waitsource {
+	enum WaitKind kind;
+	void *obj;			/* Object's userdata */
+	const void *id;		/* lua_topointer() of the argument */
+	int fd;				/* Registered fd (-1 if none) */
+	int argidx;			/* Argument's index */
+	bool ready;			/* Not pollable : always readable */
+};
+
+static int wf_epfd = -1;
+static struct waitsource wf_todo = { WK_TODO, NULL, NULL, -1, 0 };
+static struct waitsource *wf_src;	/* Supervised objects */
+static unsigned int wf_nsrc;
+static unsigned int wf_maxsrc;		/* wf_src allocated size */
+static struct epoll_event *wf_events;
+static int wf_argsref = LUA_NOREF;	/* Table keeping supervised objects alive */
+static unsigned int wf_nready;		/* Number of always readable sources */
+
+static int wf_getfd(struct waitsource *src){
+/* Current fd of a supervised object */
+	switch(src->kind){
+	case WK_FILE :
+		return fileno(*((FILE **)src->obj));
+	case WK_TIMER :
+		return ss_selTimer->getFD(src->obj);
+	case WK_EVENT :
+		return ss_selEvent->getFD(src->obj);
+	default :
+		return ssc_getToDoListFD();
+	}
+}
+
+static bool wf_unchanged(lua_State *L){
+/* Is the set still valid for WaitFor()'s arguments ? */
+	if(wf_epfd == -1 || wf_nsrc != lua_gettop(L))
+		return false;
+
+	for(unsigned int i=0; i<wf_nsrc; i++){
+		if(wf_src[i].id != lua_topointer(L, i+1) || wf_src[i].fd != wf_getfd(&wf_src[i]))
+			return false;
+	}
+
+	return true;
+}
+
+static int wf_rebuild(lua_State *L){
+/* Rebuild the set from arguments.
+ * -> 0 if succeeded, otherwise a SelError is pushed on the stack
  */
-	unsigned int nsup=0;	/* Number of supervised object (used as index in the table) */
-	int nre;				/* Number of received event */
-	struct pollfd ufds[WAITMAXFD];
-	int maxarg = lua_gettop(L);
-	int i,j;
+	int nargs = lua_gettop(L);
 
-	for(j=1; j <= lua_gettop(L); j++){	/* Stacks SelTimer arguments */
-		if(nsup == WAITMAXFD){
-			ss_selError->create(L, 'E', "Exhausting number of waiting FD, please increase WAITMAXFD", true);
-			return 1;
-		}
+	if(wf_epfd != -1){	/* Drop previous set */
+		close(wf_epfd);
+		wf_epfd = -1;
+	}
+	wf_nsrc = 0;
+	wf_nready = 0;
+	luaL_unref(L, LUA_REGISTRYINDEX, wf_argsref);
+	wf_argsref = LUA_NOREF;
+
+	if(nargs > wf_maxsrc){
+		wf_maxsrc = nargs;
+		wf_src = realloc(wf_src, sizeof(struct waitsource) * wf_maxsrc);
+		assert(wf_src);
+		wf_events = realloc(wf_events, sizeof(struct epoll_event) * (wf_maxsrc + 1));
+		assert(wf_events);
+	} else if(!wf_events){
+		wf_events = malloc(sizeof(struct epoll_event));
+		assert(wf_events);
+	}
 
+	for(int j=1; j <= nargs; j++){	/* Identify arguments */
+		struct waitsource *src = &wf_src[j-1];
 		void *r;
-		if(( r = ss_selLua->testudata(L, j, LUA_FILEHANDLE))){	/* We got a file */
-			ufds[nsup].fd = fileno(*((FILE **)r));
-			ufds[nsup++].events = POLLIN;
-		} else if((r = ss_selLua->testudata(L, j, "SelTimer"))){	/* We got a SelTimer */
+
+		if(( r = ss_selLua->testudata(L, j, LUA_FILEHANDLE)))	/* We got a file */
+			src->kind = WK_FILE;
+		else if((r = ss_selLua->testudata(L, j, "SelTimer"))){	/* We got a SelTimer */
 			if(!ss_selTimer){
 				ss_selError->create(L, 'E', "SelTimer module is not loaded", true);
 				return 1;
-			} else {
-				ufds[nsup].fd = ss_selTimer->getFD(r);
-				ufds[nsup++].events = POLLIN;
 			}
-		} else if((r = ss_selLua->testudata(L, j, "SelEvent"))){	/* We got a SelTimer */
+			src->kind = WK_TIMER;
+		} else if((r = ss_selLua->testudata(L, j, "SelEvent"))){	/* We got a SelEvent */
 			if(!ss_selEvent){
 				ss_selError->create(L, 'E', "SelEvent module is not loaded", true);
 				return 1;
-			} else {
-				ufds[nsup].fd = ss_selEvent->getFD(r);
-				ufds[nsup++].events = POLLIN;
 			}
+			src->kind = WK_EVENT;
 		} else if(lua_type(L, j) == LUA_TNIL){
 			ss_selLog->Log('E', "Argument #%d is unset", j);
 			ss_selError->create(L, 'E', "Argument is unset", false);
@@ -188,81 +246,162 @@ static int ssl_WaitFor(lua_State *L){
 			ss_selError->create(L, 'E', "Unsupported type for WaitFor()", false);
 			return 1;
 		}
+
+		src->obj = r;
+		src->id = lua_topointer(L, j);
+		src->fd = wf_getfd(src);
+		src->argidx = j;
+		src->ready = false;
+	}
+
+	if((wf_epfd = epoll_create1(EPOLL_CLOEXEC)) == -1){
+		ss_selError->create(L, 'E', strerror(errno), true);
+		return 1;
 	}
 
-		/* at least, we have to supervise todo list */
-	if(nsup == WAITMAXFD){
-		ss_selError->create(L, 'E', "Exhausting number of waiting FD, please increase WAITMAXFD", true);
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+
+	ev.data.ptr = &wf_todo;	/* at least, we have to supervise todo list */
+	if(epoll_ctl(wf_epfd, EPOLL_CTL_ADD, ssc_getToDoListFD(), &ev) == -1){
+		ss_selError->create(L, 'E', strerror(errno), true);
+		close(wf_epfd);
+		wf_epfd = -1;
 		return 1;
 	}
 
-	ufds[nsup].fd = ssc_getToDoListFD();	/* Push todo list's fd */
-	ufds[nsup].events = POLLIN;
-	nsup++;
+	for(int j=0; j < nargs; j++){
+		if(wf_src[j].fd < 0)	/* Released object */
+			continue;
+
+		ev.data.ptr = &wf_src[j];
+		if(epoll_ctl(wf_epfd, EPOLL_CTL_ADD, wf_src[j].fd, &ev) == -1){
+			if(errno == EEXIST)	/* Same object provided twice */
+				continue;
+			if(errno == EPERM && wf_src[j].kind == WK_FILE){	/* Regular file */
+				bool dup = false;
+				for(int k=0; k < j; k++)
+					if(wf_src[k].ready && wf_src[k].fd == wf_src[j].fd)
+						dup = true;
+				if(!dup){
+					wf_src[j].ready = true;
+					wf_nready++;
+				}
+				continue;
+			}
+			ss_selLog->Log('E', "Argument #%d : %s", j+1, strerror(errno));
+			ss_selError->create(L, 'E', strerror(errno), true);
+			close(wf_epfd);
+			wf_epfd = -1;
+			return 1;
+		}
+	}
+	wf_nsrc = nargs;
+
+		/* Keep supervised objects alive, so their address stays meaningful */
+	lua_createtable(L, nargs, 0);
+	for(int j=1; j <= nargs; j++){
+		lua_pushvalue(L, j);
+		lua_rawseti(L, -2, j);
+	}
+	wf_argsref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	return 0;
+}
 
-		/* Waiting for events */
-	if((nre = poll(ufds, nsup, -1)) == -1){ /* Let's consider it as not fatal */
+static int ssl_WaitFor(lua_State *L){
+/** 
+ * @brief Wait for even to come or a task is scheduled.
+ *
+ *	The process is put on hold and doesn't consume any processor resources until waked up.
+ *  Have a look on *Selenites* examples directory : this function is the **most important one**
+ * to achieve resources conservatives automation with Séléné.
+ * But take also in account 
+ *  - your tasks will be executed ONLY if there is a WaitFor() loop
+ *  - It's not multitasking at all. Consequently, tasks are expected to be
+ *  as fast as possible and definitively not blocking.
+ *
+ * Supervised objects are registered only once as long as WaitFor() is
+ * called with the same arguments : calling it always with the same list
+ * is the most efficient way.
+ *
+ * @function WaitFor
+ * @param ... list of **SelTimer**, **SelEvent**, file IO.
+ * @return number of events to proceed, a SelError in case of error
+ */
+	int nre;				/* Number of received event */
+	int maxarg = lua_gettop(L);
+
+	if(!wf_unchanged(L)){
+		if(wf_rebuild(L))
+			return 1;
+	}
+
+		/* Waiting for events (not if a source is always readable) */
+	if((nre = epoll_wait(wf_epfd, wf_events, wf_nsrc + 1, wf_nready ? 0 : -1)) == -1){ /* Let's consider it as not fatal */
 		ss_selError->create(L, 'E', strerror(errno), true);
 		return 1;
 	}
 
-	for(i=0; i<nsup; i++){
-		if( ufds[i].revents ){	/* This one has data */
-			if(ufds[i].fd == ssc_getToDoListFD()){ /* Todo list's evenfd */
+	luaL_checkstack(L, nre + wf_nready, "WaitFor()");
+
+	for(int i=0; i<nre; i++){
+		struct waitsource *src = (struct waitsource *)wf_events[i].data.ptr;
+
+			/* Note : no need to check for module availability as it
+			 * has been done which checking the arguments
+			 */
+		switch(src->kind){
+		case WK_TODO :	/* Todo list's evenfd */
+			ssc_acknowledgeToDoList();
+			lua_pushcfunction(L, ssc_handleToDoList);	/*  Push the function to handle the todo list */
+			break;
+		case WK_TIMER :
+			if(!ss_selTimer->isDisabled(src->obj)){
 				uint64_t v;
-				if(read( ufds[i].fd, &v, sizeof( uint64_t )) != sizeof( uint64_t ))
-					ss_selLog->Log('E', "read(eventfd) : %s", strerror(errno));
-				lua_pushcfunction(L, ssc_handleToDoList);	/*  Push the function to handle the todo list */
-			} else for(j=1; j <= maxarg; j++){
-					/* Note : no need to check for module availability as it
-					 * has been done which checking the arguments
-					 */
-				void *r;
-				if((r=ss_selLua->testudata(L, j, "SelTimer"))){
-					if(ufds[i].fd == ss_selTimer->getFD(r) && !ss_selTimer->isDisabled(r)){
-						uint64_t v;
-						if(read( ufds[i].fd, &v, sizeof(uint64_t)) != sizeof(uint64_t))
-							ss_selLog->Log('E', "read(timerfd) : %s", strerror(errno));
-						if(ss_selTimer->getiFunc(r) != LUA_REFNIL){	/* Immediate function to be executed */
-							lua_rawgeti(L, LUA_REGISTRYINDEX, ss_selTimer->getiFunc(r));
-							if(lua_pcall(L, 0, 0, 0)){	/* Call the trigger without arg */
-								ss_selLog->Log('E', "(SelTimer ifunc) %s", lua_tostring(L, -1));
-								lua_pop(L, 1); /* pop error message from the stack */
-								lua_pop(L, 1); /* pop NIL from the stack */
-							}
-						}
-						if(ss_selTimer->getTask(r) != LUA_REFNIL){	/* Function to be pushed in todo list */
-							if(ssc_pushtask(ss_selTimer->getTask(r), ss_selTimer->getOnce(r))){
-								ss_selLog->Log('F', "Waiting task list exhausted : enlarge SO_TASKSSTACK_LEN");
-								lua_pushstring(L, "Waiting task list exhausted : enlarge SO_TASKSSTACK_LEN");
-								lua_error(L);
-								exit(EXIT_FAILURE);	/* Code never reached */
-							}
-						}
-					}
-				} else if((r=ss_selLua->testudata(L, j, "SelEvent"))){
-					if(ufds[i].fd == ss_selEvent->getFD(r)){
-						if(ssc_pushtask(ss_selEvent->getFunc(r), false) ){
-							ss_selLog->Log('F', "Waiting task list exhausted : enlarge SO_TASKSSTACK_LEN");
-							lua_pushstring(L, "Waiting task list exhausted : enlarge SO_TASKSSTACK_LEN");
-							lua_error(L);
-							exit(EXIT_FAILURE);	/* Code never reached */
-						}
+				if(read( src->fd, &v, sizeof(uint64_t)) != sizeof(uint64_t))
+					ss_selLog->Log('E', "read(timerfd) : %s", strerror(errno));
+				if(ss_selTimer->getiFunc(src->obj) != LUA_REFNIL){	/* Immediate function to be executed */
+					lua_rawgeti(L, LUA_REGISTRYINDEX, ss_selTimer->getiFunc(src->obj));
+					if(lua_pcall(L, 0, 0, 0)){	/* Call the trigger without arg */
+						ss_selLog->Log('E', "(SelTimer ifunc) %s", lua_tostring(L, -1));
+						lua_pop(L, 1); /* pop error message from the stack */
+						lua_pop(L, 1); /* pop NIL from the stack */
 					}
-				} else if(( r = ss_selLua->testudata(L, j, LUA_FILEHANDLE))){
-					if(ufds[i].fd == fileno(*((FILE **)r)))
-						lua_pushvalue(L, j);
 				}
+				if(ss_selTimer->getTask(src->obj) != LUA_REFNIL){	/* Function to be pushed in todo list */
+					int err;
+					if((err = ssc_pushtask(ss_selTimer->getTask(src->obj), ss_selTimer->getOnce(src->obj))))
+						ss_selLog->Log('E', "SelTimer's task dropped : %s", strerror(err));
+				}
+			}
+			break;
+		case WK_EVENT :
+			{
+				int err;
+				if((err = ssc_pushtask(ss_selEvent->getFunc(src->obj), false)))
+					ss_selLog->Log('E', "SelEvent's task dropped : %s", strerror(err));
 			}
+			break;
+		case WK_FILE :
+			lua_pushvalue(L, src->argidx);
+			break;
 		}
 	}
 
+	if(wf_nready){
+		for(unsigned int i=0; i<wf_nsrc; i++)
+			if(wf_src[i].ready)
+				lua_pushvalue(L, wf_src[i].argidx);
+	}
+
 	return lua_gettop(L)-maxarg;	/* Number of stuffs to proceed */
 }
 
 static const struct luaL_Reg seleneExtLib[] = {	/* Extended ones */
 	{"WaitFor", ssl_WaitFor},
 	{"SigIntTask", ssl_SigIntTask},
+	{"ConfigureToDoList", ssl_ConfigureToDoList},
 	{NULL, NULL} /* End of definition */
 };
 
@@ -295,6 +434,9 @@ static const struct luaL_Reg seleneLib[] = {
 	{"Sleep", ssl_Sleep},
 	{"RegisterFunction", ssl_registerfunc},
 	{"TaskOnceConst", ssl_TaskOnceConst},
+	{"TaskPriorityConst", ssl_TaskPriorityConst},
+	{"TaskOverflowConst", ssl_TaskOverflowConst},
+	{"ToDoListStats", ssl_ToDoListStats},
 	{"PushTaskByRef", ssl_PushTaskByRef},
 	{"PushTask", ssl_PushTask},
 	{"HasWaitingTask", ssl_HWTask},
@@ -361,11 +503,9 @@ bool InitModule( void ){
 	lua_newtable(ss_selLua->getLuaState());
 	lua_setglobal(ss_selLua->getLuaState(), FUNCREFLOOKTBL);
 
-		/* initialize evenfd */
-	if((tlfd = eventfd( 0, 0 )) == -1){
-		ss_selLog->Log('E', "SelLua's eventfd() : %s", strerror(errno));
+		/* initialize todo list */
+	if(!ssc_initToDoList())
 		return false;
-	}
 
 		/* Register methods to main state
 		 * Can't be called using ss_selLog.module.initLua as not loaded by
@@ -2,6 +2,13 @@
  *
  * Task list management
  *
+ * The todo list is made of lock-free multi-producers / single-consumer
+ * queues, one per priority lane : any thread (MQTT callbacks, detached
+ * functions ...) can push tasks without contention, only the main thread
+ * consumes them (ssc_handleToDoList()).
+ * Signal handlers can't push (malloc() is not async-signal-safe) : they
+ * only raise a flag, the task is pushed by the main thread.
+ *
  * 14/02/2024 First version
  */
 
@@ -13,80 +20,484 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <signal.h>	/* sig_atomic_t */
 
 #if LUA_VERSION_NUM <= 501
 #define lua_rawlen lua_objlen
 #endif
 
-static int todo[TASKSSTACK_LEN];	/* pending tasks list */
-static unsigned int ctask;			/* current task index */
-static unsigned int maxtask;		/* top of the task stack */
-static pthread_mutex_t mutex_tl;	/* tasklist protection */
+	/* ***
+	 * Pending tasks
+	 * ***/
+
+struct task {
+	struct task *_Atomic next;
+	int funcref;		/* Function to execute */
+	unsigned int seq;	/* funcref's sequence when pushed */
+	bool tracked;		/* Accounted in funcref's taskstate */
+};
+
+	/* ***
+	 * Priority lanes, drained from the highest priority to the lowest one.
+	 * To avoid starvation, a lower lane is served after it has been
+	 * skipped tl_starvation times in favor of higher ones.
+	 * ***/
+
+enum {
+	LANE_CRITICAL = 0,
+	LANE_NORMAL,
+	LANE_BACKGROUND,
+	TL_LANES
+};
+
+struct lane {
+	struct task stub;	/* Empty queue marker */
+	struct task *_Atomic head;	/* Last pushed task (producers' side) */
+	struct task *tail;			/* Next task to run (consumer's side) */
+	atomic_uint pending;	/* Number of tasks in this lane */
+	unsigned int skipped;	/* Consumer only : served tasks while this lane was waiting */
+};
+
+static struct lane lanes[TL_LANES];
+static atomic_uint tl_starvation = 16;	/* 0 : strict priority */
+
+static atomic_uint tl_pending;	/* Number of tasks in the queue */
+static atomic_bool tl_signaled;	/* eventfd already notified and not yet acknowledged */
 int tlfd;	/* Task list file descriptor for eventfd */
+static pthread_t tl_consumer;	/* main thread, the only one handling the list */
+
+	/* ***
+	 * Back-pressure
+	 *
+	 * The list grows as needed. When the number of pending tasks reaches
+	 * the high-water mark, the overflow policy is applied.
+	 * ***/
+
+static atomic_uint tl_highwater = TASKSSTACK_LEN;	/* 0 : unlimited */
+static atomic_int tl_policy = TOV_DROP_NEWEST;
+static atomic_ulong tl_timeout = 1000;	/* TOV_BLOCK : maximum waiting time (ms) */
+static atomic_uint tl_dropreq;	/* Oldest tasks to drop by the consumer */
+
+static atomic_uint tl_waiters;	/* Number of producers blocked */
+static pthread_mutex_t tl_blockmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tl_space = PTHREAD_COND_INITIALIZER;
+
+	/* ***
+	 * Drain budget : maximum number of tasks and/or time spent by
+	 * a single ssc_handleToDoList() call, to let WaitFor() handle timers and
+	 * events in between (0 : unlimited).
+	 * ***/
+
+static atomic_uint tl_budgettasks;
+static atomic_uint tl_budgetus;	/* micro-seconds */
+
+	/* Statistics */
+static atomic_ulong tl_sliced;	/* Drains stopped by the budget */
+static atomic_ulong tl_pushed;
+static atomic_uint tl_peak;
+static atomic_ulong tl_droppednewest;
+static atomic_ulong tl_droppedoldest;
+static atomic_ulong tl_timeouts;
+
+	/* ***
+	 * Per function reference state, to handle TO_ONCE and TO_LAST
+	 * without scanning the queue.
+	 *
+	 * Stored in chunks that are allocated on demand and never released :
+	 * lookups don't need any lock.
+	 * ***/
+
+struct taskstate {
+	atomic_uint queued;	/* Number of occurrences in the queue */
+	atomic_uint seq;	/* Bumped by TO_LAST : occurrences pushed with an older sequence are discarded */
+};
 
-int ssc_pushtask(int funcref, enum TaskOnce once){
+#define TS_CHUNK 256		/* Number of states per chunk */
+#define TS_MAXCHUNKS 1024	/* Maximum number of chunks */
+
+static struct taskstate *_Atomic tstates[TS_MAXCHUNKS];
+
+static atomic_bool tl_untracked;	/* A task without state has already been reported */
+
+static struct taskstate *getTaskState(int funcref, bool create){
+/* Returns the state of a function reference
+ * (or NULL if out of range, not allocated and create is false or
+ * allocation failed)
+ */
+	if(funcref < 0 || funcref >= TS_CHUNK * TS_MAXCHUNKS)
+		return NULL;
+
+	struct taskstate *_Atomic *slot = &tstates[funcref / TS_CHUNK];
+	struct taskstate *chunk = atomic_load(slot);
+
+	if(!chunk){	/* Not allocated yet */
+		if(!create)
+			return NULL;
+
+		struct taskstate *new = calloc(TS_CHUNK, sizeof(struct taskstate));
+		if(!new)
+			return NULL;
+
+		if(atomic_compare_exchange_strong(slot, &chunk, new))
+			chunk = new;
+		else	/* Another thread was faster : chunk has been updated */
+			free(new);
+	}
+
+	return &chunk[funcref % TS_CHUNK];
+}
+
+static int tl_lane(int once){
+/* Priority lane from "once" argument */
+	switch(once & TP_MASK){
+	case TP_CRITICAL :
+		return LANE_CRITICAL;
+	case TP_BACKGROUND :
+		return LANE_BACKGROUND;
+	default :
+		return LANE_NORMAL;
+	}
+}
+
+static void tl_enqueue(struct lane *l, struct task *t){
+	atomic_store_explicit(&t->next, NULL, memory_order_relaxed);
+	struct task *prev = atomic_exchange(&l->head, t);
+	atomic_store(&prev->next, t);
+}
+
+static struct task *tl_dequeue(struct lane *l){
+/* Consumer side only.
+ * May return NULL even if a task is pending, when a producer is in the
+ * middle of its push : this producer will notify the eventfd afterward.
+ */
+	struct task *tail = l->tail;
+	struct task *next = atomic_load(&tail->next);
+
+	if(tail == &l->stub){
+		if(!next)	/* Empty */
+			return NULL;
+		l->tail = tail = next;
+		next = atomic_load(&next->next);
+	}
+
+	if(next){
+		l->tail = next;
+		return tail;
+	}
+
+	if(tail != atomic_load(&l->head))	/* A push is in progress */
+		return NULL;
+
+	tl_enqueue(l, &l->stub);	/* Let the last task go */
+
+	if((next = atomic_load(&tail->next))){
+		l->tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+static struct task *tl_next(void){
+/* Consumer side only : next task to run, respecting priorities */
+	unsigned int guard = atomic_load(&tl_starvation);
+	struct task *t = NULL;
+	int i;
+
+	if(guard){	/* Starving lanes first */
+		for(i = LANE_CRITICAL + 1; i < TL_LANES; i++){
+			if(lanes[i].skipped >= guard && (t = tl_dequeue(&lanes[i])))
+				break;
+		}
+	}
+
+	if(!t){
+		for(i = LANE_CRITICAL; i < TL_LANES; i++){
+			if((t = tl_dequeue(&lanes[i])))
+				break;
+		}
+	}
+
+	if(!t)
+		return NULL;
+
+	atomic_fetch_sub(&lanes[i].pending, 1);
+	lanes[i].skipped = 0;
+	for(int j = i + 1; j < TL_LANES; j++){	/* Lower lanes have been bypassed */
+		if(atomic_load(&lanes[j].pending))
+			lanes[j].skipped++;
+	}
+
+	return t;
+}
+
+static struct task *tl_nextDropped(void){
+/* Consumer side only : overflow's victim, the oldest task of the lowest lane */
+	for(int i = TL_LANES - 1; i >= LANE_CRITICAL; i--){
+		struct task *t = tl_dequeue(&lanes[i]);
+		if(t){
+			atomic_fetch_sub(&lanes[i].pending, 1);
+			return t;
+		}
+	}
+
+	return NULL;
+}
+
+static void tl_wakeup(void){
+/* Notify the main thread that tasks are waiting.
+ * Only the first push after an acknowledgement writes to the eventfd.
+ */
+	if(!atomic_exchange(&tl_signaled, true)){
+		uint64_t v = 1;
+		write(tlfd, &v, sizeof(v));
+	}
+}
+
+void ssc_acknowledgeToDoList(void){
 /**
- * @brief Push funcref in the stack
- * @function ssc_pushtask
- * @tparam integer function reference
- * @param once MULTIPLE/ONCE (default)/LAST
- * @return 0 : noerror, EUCLEAN = stack full
+ * @brief Read the todo list's eventfd and re-arm notifications
+ *
+ * Has to be called before the list is handled : pushes done after are
+ * notifying again.
+ *
+ * @function acknowledgeToDoList
  */
+	uint64_t v;
+	if(read(tlfd, &v, sizeof(uint64_t)) != sizeof(uint64_t))
+		ss_selLog->Log('E', "read(eventfd) : %s", strerror(errno));
+
+	atomic_store(&tl_signaled, false);
+}
+
+	/* ***
+	 * Signal's task
+	 * ***/
+
+static int tl_sigfunc = LUA_REFNIL;	/* Task to push when a signal is received */
+static volatile sig_atomic_t tl_sigraised;
+
+void ssc_setSignalTask(int funcref){
+	tl_sigfunc = funcref;
+}
+
+void ssc_raiseSignalTask(void){
+/**
+ * @brief Request the signal's task to be pushed
+ *
+ * Called from signal handlers : only async-signal-safe operations.
+ * The eventfd is written unconditionally to wake up WaitFor().
+ *
+ * @function raiseSignalTask
+ */
+	int err = errno;
 	uint64_t v = 1;
-	pthread_mutex_lock(&mutex_tl);
-
-	if(once != TO_MULTIPLE){
-		unsigned int i;
-		for(i=ctask; i<maxtask; i++){
-			if(todo[i % TASKSSTACK_LEN] == funcref){	/* Already in the stack */
-				if(once == TO_LAST)	/* Put it at the end of the queue */
-					todo[i % TASKSSTACK_LEN] = LUA_REFNIL;	/* Remove previous reference */
-				else {	/* TO_ONCE : Don't push a new one */
-					write(tlfd, &v, sizeof(v));
-					pthread_mutex_unlock(&mutex_tl);
-
-					return 0;
-				}
+
+	tl_sigraised = 1;
+	write(tlfd, &v, sizeof(v));
+
+	errno = err;
+}
+
+static bool tl_full(void){
+	unsigned int hw = atomic_load(&tl_highwater);
+	if(!hw)
+		return false;
+
+		/* Both counters are updated separately by the consumer :
+		 * the difference may be transiently negative.
+		 */
+	long remaining = (long)atomic_load(&tl_pending) - (long)atomic_load(&tl_dropreq);
+	if(remaining < 0)
+		remaining = 0;
+
+	return(remaining >= hw);
+}
+
+static int tl_reserve(void){
+/* Apply the overflow policy if the list is full
+ * -> 0 if the task can be pushed, the error code otherwise
+ */
+	if(!tl_full())
+		return 0;
+
+	switch(atomic_load(&tl_policy)){
+	case TOV_DROP_OLDEST :	/* Consumer will skip the oldest one */
+		atomic_fetch_add(&tl_dropreq, 1);
+		return 0;
+	case TOV_BLOCK :
+		if(!pthread_equal(pthread_self(), tl_consumer)){	/* The main thread can't wait for itself */
+			struct timespec ts;
+			unsigned long int timeout = atomic_load(&tl_timeout);
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += (time_t)(timeout / 1000);
+			ts.tv_nsec += (long)(timeout % 1000) * 1000000L;
+			if(ts.tv_nsec >= 1000000000){
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
 			}
+
+			int err = 0;
+			pthread_mutex_lock(&tl_blockmutex);
+			atomic_fetch_add(&tl_waiters, 1);
+			while(tl_full() && err != ETIMEDOUT)
+				err = pthread_cond_timedwait(&tl_space, &tl_blockmutex, &ts);
+			atomic_fetch_sub(&tl_waiters, 1);
+			pthread_mutex_unlock(&tl_blockmutex);
+
+			if(err != ETIMEDOUT)
+				return 0;
+
+			atomic_fetch_add(&tl_timeouts, 1);
+			return ETIMEDOUT;
 		}
+		/* Falls through */
+	default :	/* TOV_DROP_NEWEST */
+		atomic_fetch_add(&tl_droppednewest, 1);
+		return EUCLEAN;
 	}
+}
+
+int ssc_pushtask(int funcref, enum TaskOnce once){
+/**
+ * @brief Push funcref in the stack
+ * @function ssc_pushtask
+ * @tparam integer function reference
+ * @param once MULTIPLE/ONCE (default)/LAST, optionally combined with a TaskPriority
+ * @return 0 : noerror, EUCLEAN = list full, ETIMEDOUT = list still full after waiting, ENOMEM = can't allocate the task, ERANGE = ONCE or LAST requested but the task can't be tracked
+ */
+	if(funcref == LUA_REFNIL)	/* Nothing to do */
+		return 0;
+
+	struct taskstate *st = getTaskState(funcref, true);
+	unsigned int seq = 0;
+	int err;
 
-	if(maxtask - ctask >= TASKSSTACK_LEN){	/* Task is full */
-		write(tlfd, &v, sizeof(v));	/* even if our task is not added, unlock others to try to resume this loosing condition */
-		pthread_mutex_unlock(&mutex_tl);
-		return(errno = EUCLEAN);
+	if(!st && (once & TO_MASK) != TO_MULTIPLE){	/* Can't be deduplicated : reject it */
+		if(!atomic_exchange(&tl_untracked, true))
+			ss_selLog->Log('E', "Task %d can't be tracked : its ONCE and LAST pushes are rejected", funcref);
+		return(errno = ERANGE);
 	}
 
-	todo[maxtask++ % TASKSSTACK_LEN] = funcref;
+	if(st && (once & TO_MASK) == TO_ONCE){
+		unsigned int none = 0;
+		if(!atomic_compare_exchange_strong(&st->queued, &none, 1))
+			return 0;	/* Already in the list */
 
-	if(!(ctask % TASKSSTACK_LEN)){	/* Avoid counter to overflow */
-		ctask %= TASKSSTACK_LEN;
-		maxtask %= TASKSSTACK_LEN;
+		if((err = tl_reserve())){
+			atomic_fetch_sub(&st->queued, 1);
+			return(errno = err);
+		}
+		seq = atomic_load(&st->seq);
+	} else {
+		if((err = tl_reserve()))
+			return(errno = err);
+
+		if(st){
+			atomic_fetch_add(&st->queued, 1);
+			if((once & TO_MASK) == TO_LAST)	/* Discard previous occurrences */
+				seq = atomic_fetch_add(&st->seq, 1) + 1;
+			else
+				seq = atomic_load(&st->seq);
+		}
 	}
 
-	write(tlfd, &v, sizeof(v));
-	pthread_mutex_unlock(&mutex_tl);
+	struct task *t = malloc(sizeof(struct task));
+	if(!t){
+		if(st)
+			atomic_fetch_sub(&st->queued, 1);
+		return(errno = ENOMEM);
+	}
+	t->funcref = funcref;
+	t->seq = seq;
+	t->tracked = !!st;
+
+	struct lane *l = &lanes[tl_lane(once)];
+	atomic_fetch_add(&l->pending, 1);
+	unsigned int pending = atomic_fetch_add(&tl_pending, 1) + 1;
+	tl_enqueue(l, t);
+	tl_wakeup();
+
+		/* Statistics */
+	atomic_fetch_add_explicit(&tl_pushed, 1, memory_order_relaxed);
+	unsigned int peak = atomic_load_explicit(&tl_peak, memory_order_relaxed);
+	while(pending > peak && !atomic_compare_exchange_weak(&tl_peak, &peak, pending));
 
 	return 0;
 }
 
+static uint64_t tl_elapsedus(struct timespec *start){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
 int ssc_handleToDoList(lua_State *L){ /* Execute functions in the ToDo list */
+	unsigned int maxtasks = atomic_load(&tl_budgettasks);
+	unsigned int maxus = atomic_load(&tl_budgetus);
+	unsigned int ran = 0;
+	struct timespec start;
+
+	if(maxus)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if(tl_sigraised){	/* A signal has been received */
+		tl_sigraised = 0;
+		if(tl_sigfunc != LUA_REFNIL)
+			ssc_pushtask(tl_sigfunc, TO_ONCE | TP_CRITICAL);
+	}
+
 	for(;;){
-		int taskid;
-		pthread_mutex_lock(&mutex_tl);
-		if(ctask == maxtask){	/* No remaining waiting task */
-			pthread_mutex_unlock(&mutex_tl);
+		if((maxtasks && ran >= maxtasks) || (maxus && ran && tl_elapsedus(&start) >= maxus)){
+			if(atomic_load(&tl_pending)){	/* Remaining tasks will be handled by next WaitFor() round */
+				atomic_fetch_add(&tl_sliced, 1);
+				tl_wakeup();
+			}
 			break;
 		}
-		taskid = todo[ctask++ % TASKSSTACK_LEN];
-		pthread_mutex_unlock(&mutex_tl);
 
-		if(taskid == LUA_REFNIL)	/* Deleted task */
+		unsigned int drop = atomic_load(&tl_dropreq);	/* Has a task to be dropped due to overflow ? */
+		while(drop && !atomic_compare_exchange_weak(&tl_dropreq, &drop, drop - 1));
+
+		struct task *t = drop ? tl_nextDropped() : tl_next();
+		if(!t){
+			if(drop)	/* Nothing to drop yet */
+				atomic_fetch_add(&tl_dropreq, 1);
+			break;
+		}
+
+		int taskid = t->funcref;
+		struct taskstate *st = t->tracked ? getTaskState(taskid, false) : NULL;
+		bool discarded = false;
+
+		if(st){
+			discarded = (t->seq != atomic_load(&st->seq));	/* Superseded by a TO_LAST push */
+			atomic_fetch_sub(&st->queued, 1);
+		}
+
+		if(drop && !discarded){
+			atomic_fetch_add(&tl_droppedoldest, 1);
+			discarded = true;
+		}
+
+		atomic_fetch_sub(&tl_pending, 1);
+		free(t);
+
+		if(atomic_load(&tl_waiters)){	/* Wake up blocked producers */
+			pthread_mutex_lock(&tl_blockmutex);
+			pthread_cond_broadcast(&tl_space);
+			pthread_mutex_unlock(&tl_blockmutex);
+		}
+
+		if(discarded)
 			continue;
 
 #ifdef DEBUG
-printf("*D* todo : %d/%d, tid : %d, stack : %d ", ctask, maxtask, taskid, lua_gettop(L));
+printf("*D* todo : %u, tid : %d, stack : %d ", atomic_load(&tl_pending), taskid, lua_gettop(L));
 #endif
+		ran++;
 		lua_rawgeti( L, LUA_REGISTRYINDEX, taskid);
 #ifdef DEBUG
 printf("-> %d (%d : %d)\n", lua_gettop(L), taskid, lua_type(L, -1) );
@@ -154,6 +565,179 @@ int ssl_TaskOnceConst(lua_State *L ){
 	return ss_selLua->findConst(L, _TO);
 }
 
+static const struct ConstTranscode _TP[] = {
+	{ "CRITICAL", TP_CRITICAL },
+	{ "NORMAL", TP_NORMAL },
+	{ "BACKGROUND", TP_BACKGROUND },
+	{ NULL, 0 }
+};
+
+int ssl_TaskPriorityConst(lua_State *L ){
+/**
+ * Transcode task's priority.
+ *
+ * **CRITICAL** : run before any other task (watchdog, alarms ...).
+ * **NORMAL** : default priority.
+ * **BACKGROUND** : run when no other task is waiting (GUI refresh ...).
+ *
+ * Priority can be added to a @{TaskOnceConst} code.
+ *
+ * @function TaskPriorityConst
+ *
+ * @tparam string priority
+ * @return code
+ * @usage
+Selene.PushTask(func, Selene.TaskOnceConst("LAST") + Selene.TaskPriorityConst("CRITICAL"))
+ */
+	return ss_selLua->findConst(L, _TP);
+}
+
+static const struct ConstTranscode _TOV[] = {
+	{ "DROP_NEWEST", TOV_DROP_NEWEST },
+	{ "DROP_OLDEST", TOV_DROP_OLDEST },
+	{ "BLOCK", TOV_BLOCK },
+	{ NULL, 0 }
+};
+
+int ssl_TaskOverflowConst(lua_State *L ){
+/**
+ * Transcode todo list's overflow policy.
+ *
+ * **DROP_NEWEST** : the task being pushed is rejected (default).
+ * **DROP_OLDEST** : the oldest pending task of the lowest priority lane is dropped.
+ * **BLOCK** : the pushing thread waits for some room, up to *timeout*.
+ * The main thread can't wait for itself : its tasks are rejected.
+ *
+ * @function TaskOverflowConst
+ *
+ * @tparam string policy
+ * @return code
+ */
+	return ss_selLua->findConst(L, _TOV);
+}
+
+int ssl_ConfigureToDoList(lua_State *L){
+/**
+ * Configure the todo list
+ *
+ * @function ConfigureToDoList
+ * @tparam table ConfigureToDoList_arguments
+ * @see ConfigureToDoList_arguments
+ * @usage
+Selene.ConfigureToDoList{ highwater=1024, policy=Selene.TaskOverflowConst("DROP_OLDEST") }
+ */
+/**
+ * Arguments for @{ConfigureToDoList}
+ *
+ * @table ConfigureToDoList_arguments
+ * @field highwater number of pending tasks triggering the overflow policy (0 : unlimited)
+ * @field policy overflow policy (see @{TaskOverflowConst})
+ * @field timeout **BLOCK** policy : maximum waiting time (seconds)
+ * @field starvation number of higher priority tasks after which a waiting lower priority one is run (0 : strict priority)
+ * @field maxtasks maximum number of tasks run by a single todo list handling (0 : unlimited, default)
+ * @field maxtime maximum time spent by a single todo list handling, in seconds (0 : unlimited, default).
+ * At least one task is run, remaining ones are kept for the next @{WaitFor} round.
+ */
+	if(!lua_istable(L, 1)){
+		lua_pushnil(L);
+		lua_pushstring(L, "Selene.ConfigureToDoList() is expecting a table");
+		return 2;
+	}
+
+	lua_pushstring(L, "highwater");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER){
+		lua_Integer hw = lua_tointeger(L, -1);
+		atomic_store(&tl_highwater, hw > 0 ? (unsigned int)hw : 0);
+	}
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "policy");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER){
+		int policy = lua_tointeger(L, -1);
+		if(!ss_selCore->rfindConst(policy, _TOV)){
+			lua_pop(L, 1);
+			lua_pushnil(L);
+			lua_pushstring(L, "Unknown overflow policy");
+			return 2;
+		}
+		atomic_store(&tl_policy, policy);
+	}
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "timeout");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER){
+		lua_Number t = lua_tonumber(L, -1);
+		atomic_store(&tl_timeout, t > 0 ? (unsigned long int)(t * 1000) : 0);
+	}
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "starvation");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER){
+		lua_Integer sg = lua_tointeger(L, -1);
+		atomic_store(&tl_starvation, sg > 0 ? (unsigned int)sg : 0);
+	}
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "maxtasks");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER){
+		lua_Integer mt = lua_tointeger(L, -1);
+		atomic_store(&tl_budgettasks, mt > 0 ? (unsigned int)mt : 0);
+	}
+	lua_pop(L, 1);
+
+	lua_pushstring(L, "maxtime");
+	lua_gettable(L, 1);
+	if(lua_type(L, -1) == LUA_TNUMBER){
+		lua_Number mt = lua_tonumber(L, -1);
+		atomic_store(&tl_budgetus, mt > 0 ? (unsigned int)(mt * 1e6) : 0);
+	}
+	lua_pop(L, 1);
+
+	return 0;
+}
+
+int ssl_ToDoListStats(lua_State *L){
+/**
+ * Todo list statistics
+ *
+ * @function ToDoListStats
+ * @treturn table with **pending**, **peak**, **pushed**, **dropped_newest**, **dropped_oldest**, **timeouts** and **highwater** fields.
+ * **critical**, **normal** and **background** are the number of tasks pending in each lane.
+ * **sliced** is the number of handlings stopped by the drain budget.
+ */
+	lua_newtable(L);
+
+	lua_pushinteger(L, atomic_load(&tl_pending));
+	lua_setfield(L, -2, "pending");
+	lua_pushinteger(L, atomic_load(&tl_peak));
+	lua_setfield(L, -2, "peak");
+	lua_pushinteger(L, atomic_load(&tl_pushed));
+	lua_setfield(L, -2, "pushed");
+	lua_pushinteger(L, atomic_load(&tl_droppednewest));
+	lua_setfield(L, -2, "dropped_newest");
+	lua_pushinteger(L, atomic_load(&tl_droppedoldest));
+	lua_setfield(L, -2, "dropped_oldest");
+	lua_pushinteger(L, atomic_load(&tl_timeouts));
+	lua_setfield(L, -2, "timeouts");
+	lua_pushinteger(L, atomic_load(&tl_highwater));
+	lua_setfield(L, -2, "highwater");
+	lua_pushinteger(L, atomic_load(&tl_sliced));
+	lua_setfield(L, -2, "sliced");
+	lua_pushinteger(L, atomic_load(&lanes[LANE_CRITICAL].pending));
+	lua_setfield(L, -2, "critical");
+	lua_pushinteger(L, atomic_load(&lanes[LANE_NORMAL].pending));
+	lua_setfield(L, -2, "normal");
+	lua_pushinteger(L, atomic_load(&lanes[LANE_BACKGROUND].pending));
+	lua_setfield(L, -2, "background");
+
+	return 1;
+}
+
 int ssl_PushTaskByRef(lua_State *L){
 /**
  * Push a task by its reference
@@ -166,6 +750,7 @@ int ssl_PushTaskByRef(lua_State *L){
  *
  * @param reference function's reference
  * @param once **true** : ONCE (default), **false** : MULTIPLE or **Selene.TaskOnceConst("LAST")**
+ * @param priority **Selene.TaskPriorityConst()** (optional)
  */
 	enum TaskOnce once = TO_ONCE;
 	if(lua_type(L, 1) != LUA_TNUMBER){
@@ -179,6 +764,9 @@ int ssl_PushTaskByRef(lua_State *L){
 	else if( lua_type(L, 2) == LUA_TNUMBER )
 		once = lua_tointeger(L, 2);
 
+	if( lua_type(L, 3) == LUA_TNUMBER )
+		once = (once & TO_MASK) | (lua_tointeger(L, 3) & TP_MASK);
+
 	int err = ssc_pushtask( lua_tointeger(L, 1), once);
 	if(err){
 		lua_pushnil(L);
@@ -201,6 +789,7 @@ int ssl_PushTask(lua_State *L){
  *
  * @tparam function function
  * @param once **true** : ONCE (default), **false** : MULTIPLE or **SelShared.TaskOnceConst("LAST")**
+ * @param priority **Selene.TaskPriorityConst()** (optional)
  */
 	enum TaskOnce once = TO_ONCE;
 	if(lua_type(L, 1) != LUA_TFUNCTION ){
@@ -214,6 +803,9 @@ int ssl_PushTask(lua_State *L){
 	else if( lua_type(L, 2) == LUA_TNUMBER )
 		once = lua_tointeger(L, 2);
 
+	if( lua_type(L, 3) == LUA_TNUMBER )
+		once = (once & TO_MASK) | (lua_tointeger(L, 3) & TP_MASK);
+
 	int err = ssc_pushtask(ssc_findFuncRef(L,1), once);
 	if(err){
 		lua_pushnil(L);
@@ -224,26 +816,64 @@ int ssl_PushTask(lua_State *L){
 	return 0;
 }
 
+bool ssc_initToDoList(void){
+/**
+ * @brief Initialise the todo list
+ *
+ * Has to be called by the main thread as it will be the one handling tasks.
+ *
+ * @function initToDoList
+ * @treturn boolean succeeded or not
+ */
+	tl_consumer = pthread_self();
+
+	for(int i = 0; i < TL_LANES; i++){
+		lanes[i].head = lanes[i].tail = &lanes[i].stub;
+		atomic_store(&lanes[i].stub.next, NULL);
+	}
+
+	if((tlfd = eventfd( 0, 0 )) == -1){
+		ss_selLog->Log('E', "SelLua's eventfd() : %s", strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
 bool ssc_isToDoListEmpty(){
-	return(ctask == maxtask);
+	return(!atomic_load(&tl_pending));
 }
 
 int ssl_dumpToDoList(lua_State *L){
 /**
  * List todo list content
  *
+ * Notez-bien : only the main thread can dump the list as it is the only
+ * one consuming it.
+ *
  * @function dumpToDoList
  */
-	pthread_mutex_lock( &mutex_tl );
-	printf("*D* Dumping pending tasks list : %d / %d\n", ctask, maxtask);
-	if(maxtask)
+	if(L != ss_selLua->getLuaState()){
+		ss_selLog->Log('E', "Selene.dumpToDoList() can be called only by the main thread");
+		return 0;
+	}
+
+	unsigned int pending = atomic_load(&tl_pending);
+	printf("*D* Dumping pending tasks list : %u\n", pending);
+	if(pending)
 		printf("\t");
-	for(int i=ctask; i<maxtask; i++)
-		printf("%x ", todo[i % TASKSSTACK_LEN]);
-	pthread_mutex_unlock( &mutex_tl );
-	if(maxtask)
+	for(int i = 0; i < TL_LANES; i++){
+		for(struct task *t = lanes[i].tail; t; t = atomic_load(&t->next)){
+			if(t == &lanes[i].stub)
+				continue;
+
+			struct taskstate *st = t->tracked ? getTaskState(t->funcref, false) : NULL;
+			if(!st || t->seq == atomic_load(&st->seq))	/* Skip discarded ones */
+				printf("%x ", t->funcref);
+		}
+	}
+	if(pending)
 		puts("");
 
 	return 0;
 }
-
@@ -16,6 +16,12 @@
 
 #define FUNCREFLOOKTBL "__SELENE_FUNCREF"	/* Function reference lookup table */
 
+enum TaskOverflow {	/* What to do when the todo list is full */
+	TOV_DROP_NEWEST = 0,	/* Reject the task being pushed */
+	TOV_DROP_OLDEST,		/* Drop the oldest pending task */
+	TOV_BLOCK				/* Wait for some room (up to a timeout) */
+};
+
 extern struct SelScripting ss_selScripting;
 
 extern struct SelLua *ss_selLua;
@@ -24,12 +30,20 @@ extern struct SeleneCore *ss_selCore;
 extern struct SelLog *ss_selLog;
 extern int tlfd;
 
+extern bool ssc_initToDoList(void);
 extern int ssc_pushtask( int, enum TaskOnce );
 extern int ssc_handleToDoList(lua_State *);
+extern void ssc_acknowledgeToDoList(void);
+extern void ssc_setSignalTask(int);
+extern void ssc_raiseSignalTask(void);
 
 extern int ssc_findFuncRef(lua_State *, int);
 extern int ssl_registerfunc(lua_State *);
 extern int ssl_TaskOnceConst(lua_State *);
+extern int ssl_TaskPriorityConst(lua_State *);
+extern int ssl_TaskOverflowConst(lua_State *);
+extern int ssl_ConfigureToDoList(lua_State *);
+extern int ssl_ToDoListStats(lua_State *);
 extern int ssl_PushTaskByRef(lua_State *);
 extern int ssl_PushTask(lua_State *);
 extern bool ssc_isToDoListEmpty();
@@ -3,9 +3,14 @@
  * Variable shared among threads
  *
  * 05/03/2024 First version
+ * 18/10/2026 Variables are indexed in a hash table
+ * 18/10/2026 Lockless readers (seqlock and deferred free of strings)
+ * 18/10/2026 Change notification
+ * 18/10/2026 Proactive expiration of variables
+ * 18/10/2026 Snapshot and restore
  *
- * Notez-bien : don't use module's object facility as double linked list is
- * needed.
+ * Notez-bien : don't use module's object facility as variables are
+ * indexed by their own hash table.
  */
 
 #include "sharedvar.h"
@@ -13,102 +18,675 @@
 #include <Selene/SelSharedVar.h>
 #include <Selene/SeleneCore.h>
 #include <Selene/SelLog.h>
+#include <Selene/SelScripting.h>
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 
 static struct SelSharedVar selSharedVar;
 
 static struct SeleneCore *selCore;
 static struct SelLog *selLog;
 static struct SelLua *selLua;
+static struct SelScripting *selScripting;
 
-static struct SharedVar *first_shvar, *last_shvar;
-static pthread_mutex_t mutex_shvar;
+	/* ***
+	 * Variables' hash table
+	 *
+	 * A variable found is kept alive as long as its "users" counter is
+	 * raised or its mutex is held : dead variables are only removed
+	 * by the reaper (see below) when none of them is set.
+	 * Lookups don't lock buckets : new variables are published
+	 * atomically at the head of their chain, removal needs the table
+	 * to be write locked.
+	 * ***/
+
+#define SV_STRIPES	32	/* Number of locks protecting buckets' chains */
+#define SV_MINSIZE	64	/* Initial number of buckets (power of 2) */
+#define SV_MAXLOAD	2	/* Average chain length triggering a resize */
+
+static struct {
+	pthread_rwlock_t lock;	/* Write locked only to resize the table */
+	pthread_mutex_t stripes[SV_STRIPES];	/* Insertion in bucket n is protected by stripes[n % SV_STRIPES] */
+	struct SharedVar *_Atomic *buckets;
+	unsigned int size;		/* Number of buckets */
+	atomic_uint count;		/* Number of variables */
+} vars;
+
+static struct SharedVar *ssvc_lookup(const char *vn, unsigned int h, unsigned int idx){
+/* Looks for a variable in a bucket
+ * -> the table has to be read locked
+ */
+	for(struct SharedVar *v = atomic_load(&vars.buckets[idx]); v; v = v->next)
+		if((unsigned int)v->name.H == h && !strcmp(v->name.name, vn))
+			return v;
+
+	return NULL;
+}
+
+static void ssvc_resize(void){
+/* Double the number of buckets if the table is overloaded */
+	pthread_rwlock_wrlock(&vars.lock);
+
+	if(atomic_load(&vars.count) > vars.size * SV_MAXLOAD){	/* Not already done by another thread */
+		unsigned int nsize = vars.size * 2;
+		struct SharedVar *_Atomic *nbuckets = calloc(nsize, sizeof(struct SharedVar *));
+
+		if(nbuckets){	/* Otherwise, keep the current table */
+			for(unsigned int i = 0; i < vars.size; i++){
+				struct SharedVar *v, *next;
+				for(v = atomic_load(&vars.buckets[i]); v; v = next){
+					unsigned int idx = (unsigned int)v->name.H & (nsize - 1);
+					next = v->next;
+					v->next = atomic_load(&nbuckets[idx]);
+					atomic_store(&nbuckets[idx], v);
+				}
+			}
+
+			free((void *)vars.buckets);
+			vars.buckets = nbuckets;
+			vars.size = nsize;
+		}
+	}
+
+	pthread_rwlock_unlock(&vars.lock);
+}
+
+	/* ***
+	 * Change notification
+	 *
+	 * Watchers are notified after a variable is set, cleared or found dead.
+	 * Coalescing is done by the todo list (TO_ONCE tasks are queued only
+	 * once).
+	 * ***/
+
+struct watcher {
+	struct watcher *next;
+	char *pattern;	/* Variable name, MQTT wildcards allowed */
+
+	int task;	/* Task to push (LUA_REFNIL if none) */
+	enum TaskOnce once;
+
+	void (*func)(const char *, void *);	/* C callback (NULL if none) */
+	void *data;
+};
+
+static struct watcher *watchers;
+static pthread_rwlock_t watchers_lock = PTHREAD_RWLOCK_INITIALIZER;
+static atomic_uint nwatchers;	/* Avoid locking when nobody watches */
+
+static bool ssvc_match(const char *pattern, const char *name){
+/* Check if a variable name matches a pattern.
+ * As variables often hold MQTT topics, MQTT wildcards are used :
+ * '+' matches a single level, a trailing '#' matches all remaining levels.
+ */
+	for(;;){
+		if(*pattern == '#' && !pattern[1])	/* Everything remaining */
+			return true;
+
+		if(*pattern == '+'){	/* Skip a level */
+			while(*name && *name != '/')
+				name++;
+			pattern++;
+		} else {
+			while(*pattern && *pattern != '/' && *pattern == *name){
+				pattern++;
+				name++;
+			}
+			if((*pattern && *pattern != '/') || (*name && *name != '/'))
+				return false;	/* Level differs */
+		}
+
+			/* End of a level */
+		if(!*pattern || !*name){
+			if(!*pattern && !*name)
+				return true;
+			return(*pattern == '/' && pattern[1] == '#' && !pattern[2]);	/* "a/#" matches "a" */
+		}
+
+		if(*pattern != '/' || *name != '/')
+			return false;
+		pattern++;
+		name++;
+	}
+}
+
+static void ssvc_notify(const char *name){
+/* Notify watchers of a variable change */
+	if(!atomic_load(&nwatchers))
+		return;
+
+	pthread_rwlock_rdlock(&watchers_lock);
+	for(struct watcher *w = watchers; w; w = w->next){
+		if(!ssvc_match(w->pattern, name))
+			continue;
+
+		if(w->task != LUA_REFNIL && selScripting)
+			selScripting->pushtask(w->task, w->once);
+		if(w->func)
+			w->func(name, w->data);
+	}
+	pthread_rwlock_unlock(&watchers_lock);
+}
+
+static struct watcher *ssvc_addwatcher(const char *pattern, int task, enum TaskOnce once, void (*func)(const char *, void *), void *data){
+	struct watcher *w = malloc(sizeof(struct watcher));
+	assert(w);
+	assert( (w->pattern = strdup(pattern)) );
+	w->task = task;
+	w->once = once;
+	w->func = func;
+	w->data = data;
+
+	pthread_rwlock_wrlock(&watchers_lock);
+	w->next = watchers;
+	watchers = w;
+	atomic_fetch_add(&nwatchers, 1);
+	pthread_rwlock_unlock(&watchers_lock);
+
+	return w;
+}
+
+static void *ssvc_watch(const char *pattern, void (*func)(const char *, void *), void *data){
+/**
+ * @brief Call a function when matching variables change
+ *
+ * The callback is called by the thread modifying the variable, after
+ * the variable has been unlocked. It must not call unwatch().
+ *
+ * @function watch
+ * @tparam const char * pattern variable name (MQTT wildcards allowed)
+ * @tparam function callback called with the name of the variable and data
+ * @tparam void * data passed to the callback
+ * @treturn void * handle to be passed to unwatch()
+ */
+	return ssvc_addwatcher(pattern, LUA_REFNIL, TO_MULTIPLE, func, data);
+}
+
+static void ssvc_unwatch(void *handle){
+/**
+ * @brief Remove a watcher
+ *
+ * @function unwatch
+ * @tparam void * handle returned by watch()
+ */
+	pthread_rwlock_wrlock(&watchers_lock);
+	for(struct watcher **p = &watchers; *p; p = &(*p)->next){
+		if(*p == handle){
+			struct watcher *w = *p;
+			*p = w->next;
+			atomic_fetch_sub(&nwatchers, 1);
+			free(w->pattern);
+			free(w);
+			break;
+		}
+	}
+	pthread_rwlock_unlock(&watchers_lock);
+}
+
+	/* ***
+	 * Variables' content
+	 *
+	 * Modifications are done with the variable's mutex locked and
+	 * bracketed by seq increments : readers retry if seq changed or is odd.
+	 * Atomic operations on numbers only own the seq (odd) without taking
+	 * the mutex : mutex holders acquire it as well with ssvc_seqlock().
+	 * Replaced strings are retired and only freed when no reader is
+	 * accessing the variable (users counter).
+	 * ***/
+
+#define SV_SPINS 64	/* Retries before a reader falls back to the mutex */
+
+static bool ssvc_seqtrylock(struct SharedVar *v){
+/* Exclusive access to variable's content (even -> odd) */
+	unsigned int seq = atomic_load(&v->seq);
+	return !(seq & 1) && atomic_compare_exchange_weak(&v->seq, &seq, seq + 1);
+}
+
+static void ssvc_seqlock(struct SharedVar *v){
+/* Exclusive access to variable's content
+ * -> the variable's mutex is held : only short atomic operations compete
+ */
+	while(!ssvc_seqtrylock(v))
+		sched_yield();
+}
+
+#define SOT_ALLOCATED(t) ((t) == SOT_STRING || (t) == SOT_BLOB || (t) == SOT_TABLE)
+
+static const char *ssvc_newstr(const char *s, size_t len){
+/* Allocate a string content (NUL terminated) */
+	struct svstring *r = malloc(sizeof(struct svstring) + len + 1);
+	assert(r);
+
+	memcpy(r->data, s, len);
+	r->data[len] = 0;
+	return r->data;
+}
+
+static void ssvc_free(struct SharedVar *res){
+/* release variable's content
+ * -> the variable has to be locked
+ */
+	if(res->type != SOT_UNKNOWN)
+		res->changed = true;
+
+	if(SOT_ALLOCATED(res->type) && res->val.str){	/* Readers may still use it */
+		struct svstring *r = (struct svstring *)(res->val.str - offsetof(struct svstring, data));
+		r->next = atomic_load(&res->retired);
+		atomic_store(&res->retired, r);
+	}
+	res->type = SOT_UNKNOWN;
+}
+
+static void ssvc_reclaim(struct SharedVar *v){
+/* Free retired strings if no reader can access them anymore
+ * -> the variable has to be locked
+ */
+	if(atomic_load(&v->retired) && !atomic_load(&v->users)){
+		struct svstring *r, *next;
+		for(r = atomic_exchange(&v->retired, NULL); r; r = next){
+			next = r->next;
+			free(r);
+		}
+	}
+}
+
+static void ssvc_release(struct SharedVar *v){
+/* Release a variable found by findVar() without lock */
+	if(atomic_load(&v->retired) && !pthread_mutex_trylock(&v->mutex)){
+		atomic_fetch_sub(&v->users, 1);
+		ssvc_reclaim(v);	/* Free retired strings if we were the last reader */
+		pthread_mutex_unlock(&v->mutex);
+	} else
+		atomic_fetch_sub(&v->users, 1);
+}
+
+static void ssvc_unlock(struct SharedVar *v){
+/* End of modification of a variable locked by findVar() */
+	bool changed = v->changed;
+	v->changed = false;
+
+	if(changed)	/* Keep it alive for watchers */
+		atomic_fetch_add(&v->users, 1);
+
+	atomic_fetch_add(&v->seq, 1);	/* Even again : readers can use the new content */
+	ssvc_reclaim(v);
+	pthread_mutex_unlock(&v->mutex);
+
+	if(changed){	/* Watchers may access the variable */
+		ssvc_notify(v->name.name);
+		ssvc_release(v);
+	}
+}
+
+static void ssvc_read(struct SharedVar *v, enum SharedObjType *type, union SelSharedVarContent *val, size_t *len){
+/* Consistent snapshot of a variable without locking it.
+ * String's content remains valid until the variable is released.
+ */
+	for(unsigned int i = 0; i < SV_SPINS; i++){
+		unsigned int seq = atomic_load(&v->seq);
+		if(!(seq & 1)){	/* Not under modification */
+			*type = v->type;
+			*val = v->val;
+			*len = v->len;
+
+			atomic_thread_fence(memory_order_acquire);
+			if(atomic_load(&v->seq) == seq)	/* Consistent */
+				return;
+		}
+		sched_yield();
+	}
+
+		/* The variable is kept locked (getValue() ?) : wait for it */
+	pthread_mutex_lock(&v->mutex);
+	for(;;){	/* Only atomic operations may still be running */
+		unsigned int seq = atomic_load(&v->seq);
+		if(!(seq & 1)){
+			*type = v->type;
+			*val = v->val;
+			*len = v->len;
+
+			atomic_thread_fence(memory_order_acquire);
+			if(atomic_load(&v->seq) == seq)
+				break;
+		}
+		sched_yield();
+	}
+	pthread_mutex_unlock(&v->mutex);
+}
 
 static struct SharedVar *ssvc_findVar(const char *vn, bool lock){
 /**
  * @brief Find a variable
  *
+ * A locked variable is under modification : it has to be released
+ * by ssvc_unlock(). Otherwise, it has to be released by ssvc_release().
+ *
+ * Dead variables are emptied by the reaper : there is no need
+ * to check their time to live here.
+ *
  * @function findVar
  * @tparam const char *vn Variable name
  * @tparam boolean lock lock or not the variable
  */
-	int aH = selL_hash(vn);	/* get the hash of the variable name */
+	unsigned int aH = selL_hash(vn);	/* get the hash of the variable name */
 	struct SharedVar *v;
 
-	pthread_mutex_lock( &mutex_shvar );
-	for(v = first_shvar; v; v=v->succ){
-		if(v->name.H == aH && !strcmp(v->name.name, vn)){
-			if( v->death != (size_t)-1 ){
-				double diff = difftime( v->death, time(NULL) );	/* Check if the variable is still alive */
-				if(diff <= 0){	/* No ! */
-					pthread_mutex_lock( &v->mutex );
-					if(v->type == SOT_STRING)
-						free((void *)v->val.str);
-					v->type = SOT_UNKNOWN;
-					pthread_mutex_unlock( &v->mutex );
-				}
-			}
-			if(lock)
-				pthread_mutex_lock( &v->mutex );
-			pthread_mutex_unlock( &mutex_shvar );
+	pthread_rwlock_rdlock(&vars.lock);
+	if((v = ssvc_lookup(vn, aH, aH & (vars.size - 1))))
+		atomic_fetch_add(&v->users, 1);	/* Can't be reaped anymore */
+	pthread_rwlock_unlock(&vars.lock);
 
-
-			return v;
-		}
+	if(v && lock){	/* The table is not locked anymore : no lock order issue */
+		pthread_mutex_lock( &v->mutex );
+		atomic_fetch_sub(&v->users, 1);	/* Protected by the mutex now */
+		ssvc_seqlock(v);	/* Odd : readers have to wait */
 	}
-	pthread_mutex_unlock( &mutex_shvar );
-	return NULL;
+
+	return v;
 }
 
-static struct SharedVar *ssvc_findFreeOrCreateVar(const char *vname){
+static struct SharedVar *ssvc_findOrCreateVar(const char *vname){
 /**
- * @brief Empty a variable if it exists or create it
+ * @brief Find and lock a variable, create it if it doesn't exist
  *
- * @function findVar
+ * @function findOrCreateVar
  * @tparm const char *vname Variable name
  */
 	struct SharedVar *v = ssvc_findVar(vname, true);
 	
-	if(v){	/* The variable already exists */
-		if(v->type == SOT_STRING && v->val.str)	/* Free previous allocation */
-			free( (void *)v->val.str );
-		v->type = SOT_UNKNOWN;
-	} else {	/* New variable */
+	if(!v){	/* New variable */
+		unsigned int h = selL_hash(vname);
+
 		assert( (v = malloc(sizeof(struct SharedVar))) );
 		assert( (v->name.name = strdup(vname)) );
-		v->name.H = selL_hash(vname);
+		v->name.H = h;
 		v->type = SOT_UNKNOWN;
 		v->death = (time_t) -1;
+		v->heapidx = -1;
+		v->buried = false;
+		v->changed = true;
+		atomic_init(&v->seq, 1);	/* Under modification */
+		atomic_init(&v->users, 0);
+		atomic_init(&v->retired, NULL);
 		pthread_mutex_init(&v->mutex, NULL);
 		pthread_mutex_lock(&v->mutex);
+		selCore->initObject((struct SelModule *)&selSharedVar, (struct SelObject *)v);
 
-			/* Insert this new variable in the list */
-		pthread_mutex_lock( &mutex_shvar );
-		if(last_shvar){	/* the list is not empty */
-			last_shvar->succ = v;
-			v->prev = last_shvar;
-		} else {	/* First in the list */
-			first_shvar = v;
-			v->prev = NULL;
+			/* Insert this new variable in the table */
+		pthread_rwlock_rdlock(&vars.lock);
+		unsigned int idx = h & (vars.size - 1);
+		pthread_mutex_lock(&vars.stripes[idx % SV_STRIPES]);
+
+		struct SharedVar *exist = ssvc_lookup(vname, h, idx);
+		if(!exist){	/* Published only once fully initialised */
+			v->next = atomic_load(&vars.buckets[idx]);
+			atomic_store(&vars.buckets[idx], v);
 		}
-		last_shvar = v;
-		v->succ = NULL;
-		pthread_mutex_unlock(&mutex_shvar);
 
-		selCore->initObject((struct SelModule *)&selSharedVar, (struct SelObject *)v);
+		pthread_mutex_unlock(&vars.stripes[idx % SV_STRIPES]);
+		pthread_rwlock_unlock(&vars.lock);
 
+		if(exist){	/* Created meanwhile by another thread */
+			pthread_mutex_unlock(&v->mutex);
+			pthread_mutex_destroy(&v->mutex);
+			free((void *)v->name.name);
+			free(v);
+			return ssvc_findOrCreateVar(vname);
+		}
+
+		if(atomic_fetch_add(&vars.count, 1) + 1 > vars.size * SV_MAXLOAD)
+			ssvc_resize();
 	}
 
 	return v;
 }
 
-static void ssvc_free(struct SharedVar *res){	/* release variable's content */
-	if(res->type == SOT_STRING)
-		free((char *)res->val.str);
-	res->type = SOT_UNKNOWN;
+static struct SharedVar *ssvc_findFreeOrCreateVar(const char *vname){
+/**
+ * @brief Empty a variable if it exists or create it
+ *
+ * @function findVar
+ * @tparm const char *vname Variable name
+ */
+	struct SharedVar *v = ssvc_findOrCreateVar(vname);
+
+	ssvc_free(v);	/* Free previous allocation */
+	v->changed = true;
+
+	return v;
+}
+
+	/* ***
+	 * Expiration
+	 *
+	 * Variables with a time to live are kept in a min-heap ordered by
+	 * their death. A reaper thread sleeps until the earliest one, empties
+	 * it (watchers are notified) and removes it from the table when
+	 * nobody is using it anymore.
+	 * ***/
+
+static struct {
+	pthread_mutex_t mutex;	/* Locked after variables' one */
+	pthread_cond_t cond;	/* Signaled when the earliest death changes */
+	bool running;			/* Is the reaper started ? */
+
+	struct SharedVar **heap;
+	unsigned int count;
+	unsigned int size;
+
+		/* Statistics */
+	unsigned long int expired;
+	unsigned long int reaped;
+} expiry = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static void ssvc_heapset(unsigned int i, struct SharedVar *v){
+	expiry.heap[i] = v;
+	v->heapidx = i;
+}
+
+static void ssvc_heapup(unsigned int i){
+	struct SharedVar *v = expiry.heap[i];
+
+	while(i){
+		unsigned int parent = (i - 1) / 2;
+		if(expiry.heap[parent]->death <= v->death)
+			break;
+		ssvc_heapset(i, expiry.heap[parent]);
+		i = parent;
+	}
+	ssvc_heapset(i, v);
+}
+
+static void ssvc_heapdown(unsigned int i){
+	struct SharedVar *v = expiry.heap[i];
+
+	for(;;){
+		unsigned int child = 2*i + 1;
+		if(child >= expiry.count)
+			break;
+		if(child + 1 < expiry.count && expiry.heap[child + 1]->death < expiry.heap[child]->death)
+			child++;
+		if(v->death <= expiry.heap[child]->death)
+			break;
+		ssvc_heapset(i, expiry.heap[child]);
+		i = child;
+	}
+	ssvc_heapset(i, v);
+}
+
+static void ssvc_heapremove(struct SharedVar *v){
+/* -> expiry.mutex has to be locked */
+	unsigned int i = v->heapidx;
+
+	v->heapidx = -1;
+	if(i != --expiry.count){	/* Replace it by the last one */
+		ssvc_heapset(i, expiry.heap[expiry.count]);
+		ssvc_heapup(i);
+		ssvc_heapdown(expiry.heap[i]->heapidx);
+	}
+}
+
+static void *ssvc_reaper(void *);
+
+static void ssvc_setdeath(struct SharedVar *v, time_t death){
+/* Set variable's death and schedule its expiration
+ * -> the variable has to be locked
+ */
+	pthread_mutex_lock(&expiry.mutex);
+
+	v->death = death;
+	if(v->heapidx == -1){	/* New one */
+		if(expiry.count == expiry.size){
+			expiry.size = expiry.size ? expiry.size * 2 : 64;
+			assert( (expiry.heap = realloc(expiry.heap, expiry.size * sizeof(struct SharedVar *))) );
+		}
+		ssvc_heapset(expiry.count++, v);
+		ssvc_heapup(v->heapidx);
+	} else {	/* Death changed */
+		ssvc_heapup(v->heapidx);
+		ssvc_heapdown(v->heapidx);
+	}
+
+	if(!expiry.running){
+		pthread_t tid;
+
+		if(pthread_create(&tid, NULL, ssvc_reaper, NULL))
+			selLog->Log('E', "Can't create SelSharedVar's reaper : variables won't expire");
+		else {
+			pthread_detach(tid);
+			expiry.running = true;
+		}
+	}
+
+	if(expiry.heap[0] == v)	/* Earliest death changed */
+		pthread_cond_signal(&expiry.cond);
+
+	pthread_mutex_unlock(&expiry.mutex);
+}
+
+static bool ssvc_reap(struct SharedVar *v){
+/* Remove a dead variable from the table if nobody is using it
+ * -> false if it's still in use
+ * -> Only called by the reaper
+ */
+	bool reaped = false, alive = false;
+
+	pthread_rwlock_wrlock(&vars.lock);	/* No lookup can happen */
+	if(!atomic_load(&v->users) && !pthread_mutex_trylock(&v->mutex)){
+		if(v->type == SOT_UNKNOWN && v->heapidx == -1){	/* Still dead */
+			unsigned int idx = (unsigned int)v->name.H & (vars.size - 1);
+			struct SharedVar *_Atomic *p = &vars.buckets[idx];
+
+			if(atomic_load(p) == v)
+				atomic_store(p, v->next);
+			else {
+				struct SharedVar *prev = atomic_load(p);
+				while(prev->next != v)
+					prev = prev->next;
+				prev->next = v->next;
+			}
+			atomic_fetch_sub(&vars.count, 1);
+			reaped = true;
+		} else
+			alive = true;
+		pthread_mutex_unlock(&v->mutex);
+	}
+	pthread_rwlock_unlock(&vars.lock);
+
+	if(reaped){	/* Not reachable anymore */
+		ssvc_reclaim(v);
+		pthread_mutex_destroy(&v->mutex);
+		free((void *)v->name.name);
+		free(v);
+		expiry.reaped++;
+	} else if(alive)
+		v->buried = false;
+
+	return(reaped || alive);
+}
+
+static void *ssvc_reaper(void *unused){
+	struct SharedVar **grave = NULL;	/* Dead variables still in use */
+	unsigned int ngrave = 0, gravesize = 0;
+	time_t retry = 0;	/* Next attempt to reap them */
+
+	(void)unused;
+
+	pthread_mutex_lock(&expiry.mutex);
+	for(;;){
+		time_t now = time(NULL);
+
+		if(ngrave && now >= retry){	/* Try again to reap buried variables */
+			pthread_mutex_unlock(&expiry.mutex);
+			for(unsigned int i = 0; i < ngrave; ){
+				if(ssvc_reap(grave[i]))
+					grave[i] = grave[--ngrave];
+				else
+					i++;
+			}
+			retry = now + 1;
+			pthread_mutex_lock(&expiry.mutex);
+			continue;
+		}
+
+		if(expiry.count && expiry.heap[0]->death <= now){	/* Expired */
+			struct SharedVar *v = expiry.heap[0];
+			ssvc_heapremove(v);
+			pthread_mutex_unlock(&expiry.mutex);	/* Lock order : variable then expiry */
+
+				/* Only the reaper frees variables : v can't disappear */
+			pthread_mutex_lock(&v->mutex);
+			ssvc_seqlock(v);
+
+			bool dead = (v->heapidx == -1 && v->death != (time_t)-1 && v->death <= time(NULL));	/* Not rescheduled meanwhile */
+			if(dead){
+				if(v->type != SOT_UNKNOWN)
+					expiry.expired++;
+				ssvc_free(v);	/* Watchers are notified if it had a value */
+				v->death = (time_t)-1;
+			}
+			ssvc_unlock(v);
+
+			if(dead && !v->buried && !ssvc_reap(v)){	/* Still in use : retry later */
+				if(ngrave == gravesize){
+					gravesize = gravesize ? gravesize * 2 : 16;
+					assert( (grave = realloc(grave, gravesize * sizeof(struct SharedVar *))) );
+				}
+				if(!ngrave)
+					retry = now + 1;
+				grave[ngrave++] = v;
+				v->buried = true;
+			}
+
+			pthread_mutex_lock(&expiry.mutex);
+			continue;
+		}
+
+			/* Sleep until next event */
+		time_t wake = expiry.count ? expiry.heap[0]->death : 0;
+		if(ngrave && (!wake || retry < wake))
+			wake = retry;
+
+		if(wake){
+			struct timespec ts = { wake, 0 };
+			pthread_cond_timedwait(&expiry.cond, &expiry.mutex, &ts);
+		} else
+			pthread_cond_wait(&expiry.cond, &expiry.mutex);
+	}
+
+	return NULL;
 }
 
 static void ssvc_clear(const char *vname){
@@ -121,46 +699,62 @@ static void ssvc_clear(const char *vname){
 	struct SharedVar *v = ssvc_findVar(vname, true);
 	if(v){
 		ssvc_free(v);
-		pthread_mutex_unlock(&v->mutex);
+		ssvc_unlock(v);
 	}
 }
 
 static void ssvc_dump(void *){
 	struct SharedVar *v;
 
-	pthread_mutex_lock(&mutex_shvar);
+	pthread_rwlock_rdlock(&vars.lock);
 
-	selLog->Log('D', "Dumping variables list f:%p l:%p", first_shvar, last_shvar);
-	for(v = first_shvar; v; v=v->succ){
-		selLog->Log('I', "name:'%s' (h: %d) - %p prev:%p next:%p mtime:%s", v->name.name, v->name.H, v, v->prev, v->succ, selCore->ctime(&v->mtime, NULL, 0));
+	selLog->Log('D', "Dumping %u variables (%u buckets, %u expiring, %lu expired, %lu reaped)", atomic_load(&vars.count), vars.size, expiry.count, expiry.expired, expiry.reaped);
+	for(unsigned int i = 0; i < vars.size; i++){
+		pthread_mutex_lock(&vars.stripes[i % SV_STRIPES]);
+		for(v = atomic_load(&vars.buckets[i]); v; v=v->next){
+			selLog->Log('I', "name:'%s' (h: %u, bucket: %u) - %p mtime:%s", v->name.name, (unsigned int)v->name.H, i, v, selCore->ctime(&v->mtime, NULL, 0));
 
-		if(v->death != (time_t) -1){
-			double diff = difftime(v->death, time(NULL));
-			if(diff > 0)
-				selLog->Log('I', "\t%f second(s) to live", diff);
-			else
-				selLog->Log('I', "\tThis variable is dead");
-		}
+			if(v->death != (time_t) -1){
+				double diff = difftime(v->death, time(NULL));
+				if(diff > 0)
+					selLog->Log('I', "\t%f second(s) to live", diff);
+				else
+					selLog->Log('I', "\tThis variable is dead");
+			}
 
-		switch(v->type){
-		case SOT_UNKNOWN:
-			selLog->Log('I', "\tUnknown type or unset variable");
-			break;
-		case SOT_NUMBER:
-			selLog->Log('I', "\tNumber : %lf", v->val.num);
-			break;
-		case SOT_STRING:
-			selLog->Log('I', "\tDString : '%s'", v->val.str);
-			break;
-		case SOT_XSTRING:
-			selLog->Log('I', "\tXString : '%s'", v->val.str);
-			break;
-		default :
-			selLog->Log('E', "Unexpected type %d", v->type);
+			switch(v->type){
+			case SOT_UNKNOWN:
+				selLog->Log('I', "\tUnknown type or unset variable");
+				break;
+			case SOT_NUMBER:
+				selLog->Log('I', "\tNumber : %lf", v->val.num);
+				break;
+			case SOT_STRING:
+				selLog->Log('I', "\tDString : '%s'", v->val.str);
+				break;
+			case SOT_XSTRING:
+				selLog->Log('I', "\tXString : '%s'", v->val.str);
+				break;
+			case SOT_INTEGER:
+				selLog->Log('I', "\tInteger : %" PRId64, v->val.integer);
+				break;
+			case SOT_BOOLEAN:
+				selLog->Log('I', "\tBoolean : %s", v->val.boolean ? "true" : "false");
+				break;
+			case SOT_BLOB:
+				selLog->Log('I', "\tBlob : %lu byte(s)", (unsigned long)v->len);
+				break;
+			case SOT_TABLE:
+				selLog->Log('I', "\tTable : %lu byte(s) encoded", (unsigned long)v->len);
+				break;
+			default :
+				selLog->Log('E', "Unexpected type %d", v->type);
+			}
 		}
+		pthread_mutex_unlock(&vars.stripes[i % SV_STRIPES]);
 	}
 
-	pthread_mutex_unlock(&mutex_shvar);
+	pthread_rwlock_unlock(&vars.lock);
 }
 
 static void ssvc_setn(const char *vname, double content, unsigned long int ttl){
@@ -174,87 +768,1009 @@ static void ssvc_setn(const char *vname, double content, unsigned long int ttl){
  */
 	struct SharedVar *v = ssvc_findFreeOrCreateVar(vname);
 
-	v->type = SOT_NUMBER;
-	v->val.num = content;
+	v->type = SOT_NUMBER;
+	v->val.num = content;
+
+	if(ttl)
+		ssvc_setdeath(v, time(NULL) + ttl);
+	v->mtime = time(NULL);
+	ssvc_unlock(v);
+}
+
+static void ssvc_sets(const char *vname, const char *content, unsigned long int ttl){
+/**
+ * @brief Set a variable to a number
+ *
+ * @function setString
+ * @tparam const char * Variable name
+ * @tparam const char * content to put in the variable
+ * @tparam unsigned long int time to live (or 0 for immortal)
+ */
+	struct SharedVar *v = ssvc_findFreeOrCreateVar(vname);
+
+	v->type = SOT_STRING;
+	v->len = strlen(content);
+	v->val.str = ssvc_newstr(content, v->len);
+
+	if(ttl)
+		ssvc_setdeath(v, time(NULL) + ttl);
+	v->mtime = time(NULL);
+	ssvc_unlock(v);
+}
+
+static void ssvc_setsl(const char *vname, const char *content, size_t len, unsigned long int ttl){
+/**
+ * @brief Set a variable to a string of a given length (binary safe)
+ *
+ * @function setStringL
+ * @tparam const char * Variable name
+ * @tparam const char * content to put in the variable
+ * @tparam size_t content's length
+ * @tparam unsigned long int time to live (or 0 for immortal)
+ */
+	struct SharedVar *v = ssvc_findFreeOrCreateVar(vname);
+
+	v->type = SOT_STRING;
+	v->val.str = ssvc_newstr(content, len);	/* Still usable as a C string */
+	v->len = len;
+
+	if(ttl)
+		ssvc_setdeath(v, time(NULL) + ttl);
+	v->mtime = time(NULL);
+	ssvc_unlock(v);
+}
+
+static void ssvc_seti(const char *vname, int64_t content, unsigned long int ttl){
+/**
+ * @brief Set a variable to an integer
+ *
+ * @function setInteger
+ * @tparam const char * Variable name
+ * @tparam int64_t content to put in the variable
+ * @tparam unsigned long int time to live (or 0 for immortal)
+ */
+	struct SharedVar *v = ssvc_findFreeOrCreateVar(vname);
+
+	v->type = SOT_INTEGER;
+	v->val.integer = content;
+
+	if(ttl)
+		ssvc_setdeath(v, time(NULL) + ttl);
+	v->mtime = time(NULL);
+	ssvc_unlock(v);
+}
+
+static void ssvc_setb(const char *vname, bool content, unsigned long int ttl){
+/**
+ * @brief Set a variable to a boolean
+ *
+ * @function setBoolean
+ * @tparam const char * Variable name
+ * @tparam bool content to put in the variable
+ * @tparam unsigned long int time to live (or 0 for immortal)
+ */
+	struct SharedVar *v = ssvc_findFreeOrCreateVar(vname);
+
+	v->type = SOT_BOOLEAN;
+	v->val.boolean = content;
+
+	if(ttl)
+		ssvc_setdeath(v, time(NULL) + ttl);
+	v->mtime = time(NULL);
+	ssvc_unlock(v);
+}
+
+static void ssvc_setblob(const char *vname, const void *content, size_t len, unsigned long int ttl){
+/**
+ * @brief Set a variable to binary data
+ *
+ * @function setBlob
+ * @tparam const char * Variable name
+ * @tparam const void * data to put in the variable
+ * @tparam size_t data's length
+ * @tparam unsigned long int time to live (or 0 for immortal)
+ */
+	struct SharedVar *v = ssvc_findFreeOrCreateVar(vname);
+
+	v->type = SOT_BLOB;
+	v->val.str = ssvc_newstr(content, len);
+	v->len = len;
+
+	if(ttl)
+		ssvc_setdeath(v, time(NULL) + ttl);
+	v->mtime = time(NULL);
+	ssvc_unlock(v);
+}
+
+static enum SharedObjType ssvc_getType(const char *vname){
+	struct SharedVar *v = ssvc_findVar(vname, false);
+
+	if(v){
+		enum SharedObjType type;
+		union SelSharedVarContent val;
+		size_t len;
+
+		ssvc_read(v, &type, &val, &len);
+		ssvc_release(v);
+		return (type == SOT_XSTRING) ? SOT_STRING : type;
+	}
+	return SOT_UNKNOWN;
+}
+
+static union SelSharedVarContent ssvc_getValueL(const char *vname, enum SharedObjType *type, size_t *len, bool lock){
+/**
+ * @brief Get SelSharedVariableContent and its length
+ *
+ * Without lock, a string, a blob or a table may be replaced at any time :
+ * only scalars are safe.
+ *
+ * @function getValueL
+ * @tparam const char * Variable name
+ * @tparam enum SharedObjType * type of the variable
+ * @tparam size_t * content's length (strings, blobs and tables)
+ * @tparam bool lock do we have to lock the variable
+ */
+	struct SharedVar *v = ssvc_findVar(vname, lock);
+
+	if(!v){
+		*type = SOT_UNKNOWN;
+		*len = 0;
+		return (union SelSharedVarContent)0.0;
+	}
+
+	if(!lock){	/* Consistent snapshot */
+		union SelSharedVarContent val;
+
+		ssvc_read(v, type, &val, len);
+		ssvc_release(v);
+		return val;
+	}
+
+	*type = v->type;
+	*len = v->len;
+	return v->val;
+}
+
+static union SelSharedVarContent ssvc_getValue(const char *vname, enum SharedObjType *type, bool lock){
+/**
+ * @brief Get SelSharedVariableContent
+ *
+ * Without lock, a string may be replaced at any time : only numbers
+ * are safe.
+ *
+ * @function getValue
+ * @tparam const char * Variable name
+ * @tparam enum SharedObjType * type of the variable
+ * @tparam bool lock do we have to lock the variable
+ */
+	size_t len;
+
+	return ssvc_getValueL(vname, type, &len, lock);
+}
+
+static void ssvc_unlockVariable(const char *vname){
+/**
+ * @brief Unlock a variable locked by getValue()
+ *
+ * @function unlockVariable
+ * @tparam const char * Variable name
+ */
+	struct SharedVar *v = ssvc_findVar(vname, false);	/* false MANDATORY to avoid deadlock */
+	if(v){
+		ssvc_unlock(v);
+		ssvc_release(v);
+	}
+}
+
+	/* ***
+	 * Atomic operations on numbers
+	 * ***/
+
+enum svop { SVO_ADD, SVO_CAS, SVO_MIN, SVO_MAX };
+
+struct svnum {	/* SOT_NUMBER, SOT_INTEGER or SOT_UNKNOWN (unset) */
+	enum SharedObjType type;
+	union SelSharedVarContent val;
+};
+
+static double ssvc_tonum(const struct svnum *n){
+	return (n->type == SOT_INTEGER) ? (double)n->val.integer : n->val.num;
+}
+
+static int ssvc_numcmp(const struct svnum *a, const struct svnum *b){
+	if(a->type == SOT_INTEGER && b->type == SOT_INTEGER)
+		return (a->val.integer > b->val.integer) - (a->val.integer < b->val.integer);
+
+	double x = ssvc_tonum(a), y = ssvc_tonum(b);
+	return (x > y) - (x < y);
+}
+
+static int ssvc_compute(enum svop op, struct svnum *cur, const struct svnum *arg, const struct svnum *expected){
+/* Apply an operation on a variable's value
+ * -> -1 if the variable is not a number, 1 if modified, 0 otherwise
+ */
+	if(cur->type != SOT_UNKNOWN && cur->type != SOT_NUMBER && cur->type != SOT_INTEGER)
+		return -1;
+
+	switch(op){
+	case SVO_ADD:
+		if(cur->type == SOT_UNKNOWN)	/* Unset variables count as 0 */
+			*cur = *arg;
+		else if(cur->type == SOT_INTEGER && arg->type == SOT_INTEGER)	/* Wraps around like Lua */
+			cur->val.integer = (int64_t)((uint64_t)cur->val.integer + (uint64_t)arg->val.integer);
+		else {
+			cur->val.num = ssvc_tonum(cur) + ssvc_tonum(arg);
+			cur->type = SOT_NUMBER;
+		}
+		return 1;
+	case SVO_CAS:
+		if(expected->type == SOT_UNKNOWN){	/* Only if unset */
+			if(cur->type != SOT_UNKNOWN)
+				return 0;
+		} else if(cur->type == SOT_UNKNOWN || ssvc_numcmp(cur, expected))
+			return 0;
+		*cur = *arg;
+		return 1;
+	case SVO_MIN:
+	case SVO_MAX:
+		if(cur->type != SOT_UNKNOWN){
+			int c = ssvc_numcmp(arg, cur);
+			if(op == SVO_MIN ? c >= 0 : c <= 0)
+				return 0;
+		}
+		*cur = *arg;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int ssvc_atomic(const char *vname, enum svop op, struct svnum *arg, const struct svnum *expected){
+/* Apply an operation on a numerical variable.
+ * Existing variables are modified owning only their seq : neither the
+ * table nor the variable's mutex are locked (unless a modification is
+ * ongoing).
+ * -> -1 if the variable is not a number, 1 if modified, 0 otherwise.
+ *	*arg receives variable's resulting value.
+ */
+	struct SharedVar *v = ssvc_findVar(vname, false);
+	struct svnum cur;
+	bool locked = false;
+	int r;
+
+	if(!v){	/* New variable (or created meanwhile) */
+		v = ssvc_findOrCreateVar(vname);
+		cur.type = v->type;
+		cur.val = v->val;
+
+		if((r = ssvc_compute(op, &cur, arg, expected)) > 0){
+			v->type = cur.type;
+			v->val = cur.val;
+			v->mtime = time(NULL);
+			v->changed = true;
+		}
+		ssvc_unlock(v);
+
+		*arg = cur;
+		return r;
+	}
+
+	for(unsigned int i = 0; !ssvc_seqtrylock(v); i++){
+		if(i >= SV_SPINS){	/* The variable is kept locked : wait for it */
+			pthread_mutex_lock(&v->mutex);
+			ssvc_seqlock(v);
+			locked = true;
+			break;
+		}
+		sched_yield();
+	}
+
+	cur.type = v->type;
+	cur.val = v->val;
+	if((r = ssvc_compute(op, &cur, arg, expected)) > 0){
+		v->type = cur.type;
+		v->val = cur.val;
+		v->mtime = time(NULL);
+	}
+
+	atomic_fetch_add(&v->seq, 1);	/* Even again */
+	if(locked)
+		pthread_mutex_unlock(&v->mutex);
+
+	if(r > 0)
+		ssvc_notify(v->name.name);
+	ssvc_release(v);
+
+	*arg = cur;
+	return r;
+}
+
+static bool ssvc_add(const char *vname, double delta, double *res){
+/**
+ * @brief Atomically add a value to a numerical variable
+ *
+ * An unset variable is considered as 0.
+ *
+ * @function add
+ * @tparam const char * Variable name
+ * @tparam double value to add
+ * @tparam double * resulting value (if not NULL)
+ * @treturn bool false if the variable is not a number
+ */
+	struct svnum arg = { SOT_NUMBER, { .num = delta } };
+
+	if(ssvc_atomic(vname, SVO_ADD, &arg, NULL) < 0)
+		return false;
+
+	if(res)
+		*res = ssvc_tonum(&arg);
+	return true;
+}
+
+static bool ssvc_addi(const char *vname, int64_t delta, int64_t *res){
+/**
+ * @brief Atomically add an integer to a numerical variable
+ *
+ * The variable remains an integer if it was one (or unset).
+ *
+ * @function addInteger
+ * @tparam const char * Variable name
+ * @tparam int64_t value to add
+ * @tparam int64_t * resulting value (if not NULL)
+ * @treturn bool false if the variable is not a number
+ */
+	struct svnum arg = { SOT_INTEGER, { .integer = delta } };
+
+	if(ssvc_atomic(vname, SVO_ADD, &arg, NULL) < 0)
+		return false;
+
+	if(res)
+		*res = (arg.type == SOT_INTEGER) ? arg.val.integer : (int64_t)arg.val.num;
+	return true;
+}
+
+static bool ssvc_cas(const char *vname, double expected, double value){
+/**
+ * @brief Atomically set a numerical variable if it contains the expected value
+ *
+ * @function compareAndSet
+ * @tparam const char * Variable name
+ * @tparam double expected value
+ * @tparam double new value
+ * @treturn bool true if the variable has been set
+ */
+	struct svnum arg = { SOT_NUMBER, { .num = value } };
+	struct svnum exp = { SOT_NUMBER, { .num = expected } };
+
+	return(ssvc_atomic(vname, SVO_CAS, &arg, &exp) > 0);
+}
+
+static bool ssvc_casi(const char *vname, int64_t expected, int64_t value){
+/**
+ * @brief Atomically set a numerical variable to an integer if it contains the expected value
+ *
+ * @function compareAndSetInteger
+ * @tparam const char * Variable name
+ * @tparam int64_t expected value
+ * @tparam int64_t new value
+ * @treturn bool true if the variable has been set
+ */
+	struct svnum arg = { SOT_INTEGER, { .integer = value } };
+	struct svnum exp = { SOT_INTEGER, { .integer = expected } };
+
+	return(ssvc_atomic(vname, SVO_CAS, &arg, &exp) > 0);
+}
+
+static bool ssvc_minmax(const char *vname, enum svop op, double value, double *res){
+	struct svnum arg = { SOT_NUMBER, { .num = value } };
+
+	if(ssvc_atomic(vname, op, &arg, NULL) < 0)
+		return false;
+
+	if(res)
+		*res = ssvc_tonum(&arg);
+	return true;
+}
+
+static bool ssvc_min(const char *vname, double value, double *res){
+/**
+ * @brief Atomically lower a numerical variable to value if it's bigger
+ *
+ * @function min
+ * @tparam const char * Variable name
+ * @tparam double value
+ * @tparam double * resulting value (if not NULL)
+ * @treturn bool false if the variable is not a number
+ */
+	return ssvc_minmax(vname, SVO_MIN, value, res);
+}
+
+static bool ssvc_max(const char *vname, double value, double *res){
+/**
+ * @brief Atomically raise a numerical variable to value if it's smaller
+ *
+ * @function max
+ * @tparam const char * Variable name
+ * @tparam double value
+ * @tparam double * resulting value (if not NULL)
+ * @treturn bool false if the variable is not a number
+ */
+	return ssvc_minmax(vname, SVO_MAX, value, res);
+}
+
+	/* ***
+	 * Snapshot
+	 *
+	 * File format (host byte order : not portable across architectures)
+	 *	"SSVS", uint32_t version
+	 *	records : uint8_t type, uint32_t name's length, name,
+	 *		int64_t death, int64_t mtime, value
+	 *		(double, int64_t, uint8_t or uint32_t length + content)
+	 *	uint8_t SOT_UNKNOWN as end marker
+	 *	uint32_t CRC32 of everything before
+	 *
+	 * The snapshot is written in a temporary file, renamed once complete.
+	 * ***/
+
+#define SVS_MAGIC "SSVS"
+#define SVS_VERSION 1
+
+static uint32_t crctable[256];
+
+static void ssvs_initcrc(void){
+	for(uint32_t i = 0; i < 256; i++){
+		uint32_t c = i;
+		for(int j = 0; j < 8; j++)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		crctable[i] = c;
+	}
+}
+
+static uint32_t ssvs_crc(uint32_t crc, const void *data, size_t len){
+/* CRC32 (IEEE) : start with 0 */
+	const unsigned char *p = data;
+
+	crc = ~crc;
+	while(len--)
+		crc = crctable[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+struct svswriter {
+	FILE *f;
+	uint32_t crc;
+	bool error;
+};
+
+static void ssvs_write(struct svswriter *w, const void *data, size_t len){
+	if(w->error)
+		return;
+
+	w->crc = ssvs_crc(w->crc, data, len);
+	if(fwrite(data, 1, len, w->f) != len)
+		w->error = true;
+}
+
+static bool ssvc_snapshot(const char *file){
+/**
+ * @brief Save all variables to a file
+ *
+ * @function snapshot
+ * @tparam const char * file name
+ * @treturn bool false in case of error (logged)
+ */
+	struct svswriter w = { NULL, 0, false };
+	struct SharedVar **list;
+	unsigned int nbre = 0;
+	char tmp[strlen(file) + 5];
+	uint32_t u32;
+	int64_t i64;
+	uint8_t u8;
+
+		/* Keep all variables alive.
+		 * Their content can't be read under the table lock
+		 * (lock order with ssvc_resize()).
+		 */
+	pthread_rwlock_rdlock(&vars.lock);
+	unsigned int max = atomic_load(&vars.count);
+	assert( (list = malloc((max ? max : 1) * sizeof(struct SharedVar *))) );
+	for(unsigned int i = 0; i < vars.size && nbre < max; i++)
+		for(struct SharedVar *v = atomic_load(&vars.buckets[i]); v && nbre < max; v = v->next){
+			atomic_fetch_add(&v->users, 1);
+			list[nbre++] = v;
+		}
+	pthread_rwlock_unlock(&vars.lock);
+
+	sprintf(tmp, "%s.tmp", file);
+	if(!(w.f = fopen(tmp, "w"))){
+		selLog->Log('E', "%s : %s", tmp, strerror(errno));
+		for(unsigned int i = 0; i < nbre; i++)
+			ssvc_release(list[i]);
+		free(list);
+		return false;
+	}
+
+	ssvs_write(&w, SVS_MAGIC, 4);
+	u32 = SVS_VERSION;
+	ssvs_write(&w, &u32, sizeof(u32));
+
+	for(unsigned int i = 0; i < nbre; i++){
+		struct SharedVar *v = list[i];
+		enum SharedObjType type;
+		union SelSharedVarContent val;
+		size_t len;
+
+		ssvc_read(v, &type, &val, &len);
+		if(type == SOT_XSTRING){	/* Restored as a managed string */
+			type = SOT_STRING;
+			len = strlen(val.str);
+		}
+
+		if(type != SOT_UNKNOWN){
+			u8 = type;
+			ssvs_write(&w, &u8, 1);
+			u32 = strlen(v->name.name);
+			ssvs_write(&w, &u32, sizeof(u32));
+			ssvs_write(&w, v->name.name, u32);
+			i64 = v->death;
+			ssvs_write(&w, &i64, sizeof(i64));
+			i64 = v->mtime;
+			ssvs_write(&w, &i64, sizeof(i64));
+
+			switch(type){
+			case SOT_NUMBER:
+				ssvs_write(&w, &val.num, sizeof(val.num));
+				break;
+			case SOT_INTEGER:
+				ssvs_write(&w, &val.integer, sizeof(val.integer));
+				break;
+			case SOT_BOOLEAN:
+				u8 = val.boolean;
+				ssvs_write(&w, &u8, 1);
+				break;
+			default :	/* strings, blobs and tables */
+				u32 = len;
+				ssvs_write(&w, &u32, sizeof(u32));
+				ssvs_write(&w, val.str, len);
+				break;
+			}
+		}
+		ssvc_release(v);
+	}
+	free(list);
+
+	u8 = SOT_UNKNOWN;
+	ssvs_write(&w, &u8, 1);
+	u32 = w.crc;
+	ssvs_write(&w, &u32, sizeof(u32));
+
+	if(fflush(w.f) || fsync(fileno(w.f)))
+		w.error = true;
+	if(fclose(w.f))
+		w.error = true;
+
+	if(w.error || rename(tmp, file)){
+		selLog->Log('E', "%s : %s", file, strerror(errno));
+		unlink(tmp);
+		return false;
+	}
+
+	return true;
+}
+
+struct svsreader {
+	const char *p;
+	const char *end;
+};
+
+static bool ssvs_read(struct svsreader *r, void *data, size_t len){
+	if((size_t)(r->end - r->p) < len)
+		return false;
+
+	memcpy(data, r->p, len);
+	r->p += len;
+	return true;
+}
+
+static bool ssvc_restore(const char *file){
+/**
+ * @brief Restore variables saved by snapshot()
+ *
+ * Variables dead meanwhile are ignored, others are replaced.
+ *
+ * @function restore
+ * @tparam const char * file name
+ * @treturn bool false in case of error (logged)
+ */
+	FILE *f = fopen(file, "r");
+	char *buf;
+	long size;
+	struct svsreader r;
+	uint32_t u32, crc;
+	unsigned int nbre = 0;
+	time_t now = time(NULL);
+
+	if(!f){
+		selLog->Log('E', "%s : %s", file, strerror(errno));
+		return false;
+	}
+
+	if(fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET)){
+		selLog->Log('E', "%s : %s", file, strerror(errno));
+		fclose(f);
+		return false;
+	}
+
+	assert( (buf = malloc(size ? size : 1)) );
+	if(fread(buf, 1, size, f) != (size_t)size){
+		selLog->Log('E', "%s : can't read", file);
+		fclose(f);
+		free(buf);
+		return false;
+	}
+	fclose(f);
+
+		/* Check the whole file before restoring anything */
+	r.p = buf;
+	r.end = buf + size - sizeof(crc);
+	if(size < (long)(4 + sizeof(u32) + 1 + sizeof(crc)) || memcmp(buf, SVS_MAGIC, 4)){
+		selLog->Log('E', "%s : not a SelSharedVar snapshot", file);
+		free(buf);
+		return false;
+	}
+	memcpy(&crc, r.end, sizeof(crc));
+	if(ssvs_crc(0, buf, size - sizeof(crc)) != crc){
+		selLog->Log('E', "%s : corrupted snapshot", file);
+		free(buf);
+		return false;
+	}
+	r.p += 4;
+	ssvs_read(&r, &u32, sizeof(u32));
+	if(u32 != SVS_VERSION){
+		selLog->Log('E', "%s : unsupported snapshot version", file);
+		free(buf);
+		return false;
+	}
+
+	for(;;){
+		uint8_t type;
+		char *name;
+		int64_t death, mtime;
+		union SelSharedVarContent val;
+		const char *content = NULL;
+		uint32_t len = 0;
+
+		if(!ssvs_read(&r, &type, 1))
+			break;
+		if(type == SOT_UNKNOWN){	/* End marker */
+			free(buf);
+			selLog->Log('D', "%u variable(s) restored from %s", nbre, file);
+			return true;
+		}
+
+		if(!ssvs_read(&r, &u32, sizeof(u32)) || (size_t)(r.end - r.p) < u32)
+			break;
+		name = strndup(r.p, u32);
+		assert(name);
+		r.p += u32;
+
+		if(!ssvs_read(&r, &death, sizeof(death)) || !ssvs_read(&r, &mtime, sizeof(mtime))){
+			free(name);
+			break;
+		}
+
+		bool ok;
+		switch(type){
+		case SOT_NUMBER:
+			ok = ssvs_read(&r, &val.num, sizeof(val.num));
+			break;
+		case SOT_INTEGER:
+			ok = ssvs_read(&r, &val.integer, sizeof(val.integer));
+			break;
+		case SOT_BOOLEAN:
+			{
+				uint8_t b;
+				ok = ssvs_read(&r, &b, 1);
+				val.boolean = b;
+			}
+			break;
+		case SOT_STRING:
+		case SOT_BLOB:
+		case SOT_TABLE:
+			ok = ssvs_read(&r, &len, sizeof(len)) && (size_t)(r.end - r.p) >= len;
+			content = r.p;
+			r.p += ok ? len : 0;
+			break;
+		default :
+			ok = false;
+		}
+
+		if(!ok){
+			free(name);
+			break;
+		}
+
+		if(death == -1 || death > now){	/* Still alive */
+			struct SharedVar *v = ssvc_findFreeOrCreateVar(name);
+
+			v->type = type;
+			if(content){
+				v->val.str = ssvc_newstr(content, len);
+				v->len = len;
+			} else
+				v->val = val;
+
+			if(death != -1)
+				ssvc_setdeath(v, death);
+			v->mtime = mtime;
+			ssvc_unlock(v);
+			nbre++;
+		}
+		free(name);
+	}
+
+	selLog->Log('E', "%s : truncated snapshot (%u variable(s) restored)", file, nbre);
+	free(buf);
+	return false;
+}
+
+	/* Periodic snapshot */
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;	/* Signaled when the configuration changes */
+	bool running;			/* Is the thread started ? */
+	char *file;				/* NULL : no periodic snapshot */
+	unsigned long int period;	/* seconds */
+} autosnap = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static void *ssvs_autosnapshot(void *){
+	pthread_mutex_lock(&autosnap.mutex);
+	for(;;){
+		if(!autosnap.file){
+			pthread_cond_wait(&autosnap.cond, &autosnap.mutex);
+			continue;
+		}
 
-	if(ttl)
-		v->death = time(NULL) + ttl;
-	v->mtime = time(NULL);
-	pthread_mutex_unlock(&v->mutex);
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += autosnap.period;
+		if(pthread_cond_timedwait(&autosnap.cond, &autosnap.mutex, &ts) != ETIMEDOUT)
+			continue;	/* Reconfigured */
+
+		char *file = strdup(autosnap.file);
+		assert(file);
+		pthread_mutex_unlock(&autosnap.mutex);	/* Don't block reconfiguration */
+		ssvc_snapshot(file);
+		free(file);
+		pthread_mutex_lock(&autosnap.mutex);
+	}
+
+	return NULL;
 }
 
-static void ssvc_sets(const char *vname, const char *content, unsigned long int ttl){
+static bool ssvc_autoSnapshot(const char *file, unsigned long int period){
 /**
- * @brief Set a variable to a number
+ * @brief Periodically snapshot variables
  *
- * @function setString
- * @tparam const char * Variable name
- * @tparam const char * content to put in the variable
- * @tparam unsigned long int time to live (or 0 for immortal)
+ * @function autoSnapshot
+ * @tparam const char * file name (NULL to stop)
+ * @tparam unsigned long int period in seconds (0 to stop)
+ * @treturn bool false if the thread can't be created
  */
-	struct SharedVar *v = ssvc_findFreeOrCreateVar(vname);
+	bool ret = true;
 
-	v->type = SOT_STRING;
-	assert( (v->val.str = strdup(content)) );
+	pthread_mutex_lock(&autosnap.mutex);
 
-	if(ttl)
-		v->death = time(NULL) + ttl;
-	v->mtime = time(NULL);
-	pthread_mutex_unlock(&v->mutex);
+	free(autosnap.file);
+	autosnap.file = NULL;
+	if(file && period){
+		assert( (autosnap.file = strdup(file)) );
+		autosnap.period = period;
+	}
+
+	if(!autosnap.running && autosnap.file){
+		pthread_t tid;
+		if(pthread_create(&tid, NULL, ssvs_autosnapshot, NULL)){
+			selLog->Log('E', "Can't create SelSharedVar's snapshot thread");
+			free(autosnap.file);
+			autosnap.file = NULL;
+			ret = false;
+		} else {
+			pthread_detach(tid);
+			autosnap.running = true;
+		}
+	} else
+		pthread_cond_signal(&autosnap.cond);
+
+	pthread_mutex_unlock(&autosnap.mutex);
+	return ret;
 }
 
-static enum SharedObjType ssvc_getType(const char *vname){
-	struct SharedVar *v = ssvc_findVar(vname, true);
+	/* ***
+	 * Lua
+	 * ***/
 
-	if(v){
-		switch(v->type){
-		case SOT_STRING:
-		case SOT_XSTRING:
-			pthread_mutex_unlock(&v->mutex);
-			return SOT_STRING;
-		default:
-			pthread_mutex_unlock(&v->mutex);
-			return v->type;
-		}
+	/* ***
+	 * Tables' flat encoding (see SharedTableTag)
+	 * ***/
+
+#define SVT_MAXDEPTH 32	/* Nested tables limit (protects against loops as well) */
+
+struct svtbuf {	/* Encoding buffer, directly usable as variable's content */
+	struct svstring *s;
+	size_t len;
+	size_t size;
+};
+
+static void ssvt_put(struct svtbuf *b, const void *data, size_t len){
+	if(b->len + len > b->size){
+		while(b->len + len > b->size)
+			b->size *= 2;
+		b->s = realloc(b->s, sizeof(struct svstring) + b->size);
+		assert(b->s);
 	}
-	return SOT_UNKNOWN;
+	memcpy(b->s->data + b->len, data, len);
+	b->len += len;
 }
 
-static union SelSharedVarContent ssvc_getValue(const char *vname, enum SharedObjType *type, bool lock){
-/**
- * @brief Get SelSharedVariableContent
- *
- * @function getValue
- * @tparam const char * Variable name
- * @tparam enum SharedObjType * type of the variable
- * @tparam bool lock do we have to lock the variable
+static void ssvt_puttag(struct svtbuf *b, enum SharedTableTag tag){
+	unsigned char t = tag;
+	ssvt_put(b, &t, 1);
+}
+
+static const char *ssvt_encode(lua_State *L, int idx, struct svtbuf *b, unsigned int depth){
+/* Serialise the value at idx
+ * -> NULL if succeeded, an error message otherwise
  */
-	struct SharedVar *v = ssvc_findVar(vname, lock);
+	if(idx < 0)	/* lua_absindex() doesn't exist in 5.1 */
+		idx = lua_gettop(L) + idx + 1;
 
-	if(!v){
-		*type = SOT_UNKNOWN;
-		return (union SelSharedVarContent)0.0;
+	switch(lua_type(L, idx)){
+	case LUA_TNUMBER:
+#if LUA_VERSION_NUM > 502
+		if(lua_isinteger(L, idx)){
+			int64_t i = lua_tointeger(L, idx);
+			ssvt_puttag(b, SVT_INTEGER);
+			ssvt_put(b, &i, sizeof(i));
+			break;
+		}
+#endif
+		{
+			double n = lua_tonumber(L, idx);
+			ssvt_puttag(b, SVT_NUMBER);
+			ssvt_put(b, &n, sizeof(n));
+		}
+		break;
+	case LUA_TBOOLEAN:
+		{
+			unsigned char v = lua_toboolean(L, idx);
+			ssvt_puttag(b, SVT_BOOLEAN);
+			ssvt_put(b, &v, 1);
+		}
+		break;
+	case LUA_TSTRING:
+		{
+			size_t len;
+			const char *str = lua_tolstring(L, idx, &len);
+			uint32_t l = len;
+
+			if(len > UINT32_MAX)
+				return "String too long to be shared";
+			ssvt_puttag(b, SVT_STRING);
+			ssvt_put(b, &l, sizeof(l));
+			ssvt_put(b, str, len);
+		}
+		break;
+	case LUA_TTABLE:
+		if(depth >= SVT_MAXDEPTH)
+			return "Tables nested too deeply (loop ?)";
+		if(!lua_checkstack(L, 3))
+			return "Lua stack exhausted";
+
+		ssvt_puttag(b, SVT_TABLE);
+		lua_pushnil(L);
+		while(lua_next(L, idx)){
+			const char *err;
+
+			if(lua_type(L, -2) == LUA_TTABLE){
+				lua_pop(L, 2);
+				return "Tables can't be used as keys";
+			}
+			if((err = ssvt_encode(L, -2, b, depth + 1)) || (err = ssvt_encode(L, -1, b, depth + 1))){
+				lua_pop(L, 2);
+				return err;
+			}
+			lua_pop(L, 1);
+		}
+		ssvt_puttag(b, SVT_END);
+		break;
+	default:
+		return "Only numbers, strings, booleans and tables can be shared";
 	}
 
-	*type = v->type;
-	return v->val;
+	return NULL;
 }
 
-static void ssvc_unlockVariable(const char *vname){
-/**
- * @brief Unlock a variable locked by getValue()
- *
- * @function unlockVariable
- * @tparam const char * Variable name
+static bool ssvt_decode(lua_State *L, const char **p, const char *end, unsigned int depth){
+/* Push the item at *p and advance it
+ * -> false if the encoding is corrupted (nothing pushed)
  */
-	struct SharedVar *v = ssvc_findVar(vname, false);	/* false MANDATORY to avoid deadlock */
-	if(v)
-		pthread_mutex_unlock(&v->mutex);
-}
+	if(*p >= end)
+		return false;
 
-	/* ***
-	 * Lua
-	 * ***/
+	switch((unsigned char)*(*p)++){
+	case SVT_NUMBER:
+		{
+			double n;
+			if((size_t)(end - *p) < sizeof(n))
+				return false;
+			memcpy(&n, *p, sizeof(n));
+			*p += sizeof(n);
+			lua_pushnumber(L, n);
+		}
+		break;
+	case SVT_INTEGER:
+		{
+			int64_t i;
+			if((size_t)(end - *p) < sizeof(i))
+				return false;
+			memcpy(&i, *p, sizeof(i));
+			*p += sizeof(i);
+			lua_pushinteger(L, i);
+		}
+		break;
+	case SVT_BOOLEAN:
+		if(*p >= end)
+			return false;
+		lua_pushboolean(L, *(*p)++);
+		break;
+	case SVT_STRING:
+		{
+			uint32_t l;
+			if((size_t)(end - *p) < sizeof(l))
+				return false;
+			memcpy(&l, *p, sizeof(l));
+			*p += sizeof(l);
+			if((size_t)(end - *p) < l)
+				return false;
+			lua_pushlstring(L, *p, l);
+			*p += l;
+		}
+		break;
+	case SVT_TABLE:
+		if(depth >= SVT_MAXDEPTH || !lua_checkstack(L, 3))
+			return false;
+
+		lua_newtable(L);
+		for(;;){
+			if(*p >= end){
+				lua_pop(L, 1);
+				return false;
+			}
+			if(**p == SVT_END){
+				(*p)++;
+				break;
+			}
+			if(!ssvt_decode(L, p, end, depth + 1)){
+				lua_pop(L, 1);
+				return false;
+			}
+			if(!ssvt_decode(L, p, end, depth + 1)){
+				lua_pop(L, 2);
+				return false;
+			}
+			lua_rawset(L, -3);
+		}
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
 
 static int ssvl_dump(lua_State *L){
 	ssvc_dump(NULL);
@@ -268,40 +1784,93 @@ static int ssvl_set(lua_State *L){
  * @function Set
  *
  * @tparam string name the variable's name
- * @tparam ?string|number value
+ * @tparam ?string|number|boolean|table value (tables may only contain numbers, strings, booleans and tables)
  * @tparam number ttl time to live in seconds (optional)
  */
 	const char *vname = luaL_checkstring(L, 1);	/* Name of the variable to retrieve */
-	struct SharedVar *v = ssvc_findFreeOrCreateVar(vname);
+	struct svtbuf tbl = { NULL, 0, 0 };
+	struct SharedVar *v;
+
+	if(lua_type(L, 2) == LUA_TTABLE){	/* Serialised before locking the variable */
+		const char *err;
+
+		tbl.size = 256;
+		tbl.s = malloc(sizeof(struct svstring) + tbl.size);
+		assert(tbl.s);
+		if((err = ssvt_encode(L, 2, &tbl, 0))){
+			free(tbl.s);
+			lua_pushnil(L);
+			lua_pushstring(L, err);
+			return 2;
+		}
+	}
+
+	v = ssvc_findFreeOrCreateVar(vname);
 
 	switch(lua_type(L, 2)){
 	case LUA_TSTRING:
-		v->type = SOT_STRING;
-		assert( (v->val.str = strdup( lua_tostring(L, 2) )) );
+		{
+			size_t len;
+			const char *str = lua_tolstring(L, 2, &len);
+
+			v->type = SOT_STRING;
+			v->val.str = ssvc_newstr(str, len);
+			v->len = len;
+		}
 		break;
-	case LUA_TNUMBER:
+	case LUA_TNUMBER:	/* Always a SOT_NUMBER : integers are stored by SetInteger() */
 		v->type = SOT_NUMBER;
 		v->val.num = lua_tonumber(L, 2);
 		break;
+	case LUA_TBOOLEAN:
+		v->type = SOT_BOOLEAN;
+		v->val.boolean = lua_toboolean(L, 2);
+		break;
+	case LUA_TTABLE:
+		v->type = SOT_TABLE;
+		v->val.str = tbl.s->data;
+		v->len = tbl.len;
+		break;
 	case LUA_TNIL:
 		break;
 	default :
-		pthread_mutex_unlock(&v->mutex);
+		ssvc_unlock(v);
 		lua_pushnil(L);
-		lua_pushstring(L, "Shared variable can be only a Number or a String");
+		lua_pushstring(L, "Shared variable can be only a Number, a String, a Boolean or a Table");
 #ifdef DEBUG
-		selLog->Log('E', "'%s' : Shared variable can be only a Number or a String (%d)", v->name,lua_type(L, 2) );
+		selLog->Log('E', "'%s' : Shared variable can be only a Number, a String, a Boolean or a Table (%d)", v->name,lua_type(L, 2) );
 		selLog->Log('I', "'%s' is now invalid", v->name);
 #endif
 		return 2;
 	}
 
 	if(lua_type(L, 3) == LUA_TNUMBER)	/* This variable has a limited time life */
-		v->death = time(NULL) + lua_tointeger( L, 3 );
+		ssvc_setdeath(v, time(NULL) + lua_tointeger( L, 3 ));
 
 	v->mtime = time(NULL);
-	pthread_mutex_unlock( &v->mutex );
+	ssvc_unlock(v);
+
+	return 0;
+}
 
+static int ssvl_setinteger(lua_State *L){
+/**
+ * set a shared variable to an integer
+ *
+ * Stored as a 64 bits integer : unlike with @{Set}, @{Get} returns it
+ * as an integer (Lua 5.3+).
+ *
+ * @function SetInteger
+ *
+ * @tparam string name the variable's name
+ * @tparam integer value
+ * @tparam number ttl time to live in seconds (optional)
+ */
+	const char *vname = luaL_checkstring(L, 1);
+	lua_Integer val = luaL_checkinteger(L, 2);
+	lua_Integer ttl = (lua_type(L, 3) == LUA_TNUMBER) ? lua_tointeger(L, 3) : 0;
+
+	ssvc_seti(vname, val, (ttl > 0) ? ttl : 0);
 	return 0;
 }
 
@@ -312,34 +1881,301 @@ static int ssvl_get(lua_State *L){
  * @function Get
  *
  * @tparam string name the variable's name
- * @treturn ?string|number|nil content of the variable
+ * @treturn ?string|number|boolean|table|nil content of the variable (tables are new copies)
  */
 	const char *vname = luaL_checkstring(L, 1);	/* Name of the variable to retrieve */
-	struct SharedVar *v = ssvc_findVar(vname, true);
+	struct SharedVar *v = ssvc_findVar(vname, false);	/* Readers don't lock */
+	enum SharedObjType type;
+	union SelSharedVarContent val;
+	size_t len;
 
 	if(v){
-		switch(v->type){
+		ssvc_read(v, &type, &val, &len);	/* The string remains valid until released */
+
+		switch(type){
 		case SOT_STRING:
+		case SOT_BLOB:
+			lua_pushlstring(L, val.str, len);
+			break;
 		case SOT_XSTRING:
-			lua_pushstring(L, v->val.str);
+			lua_pushstring(L, val.str);
 			break;
 		case SOT_NUMBER:
-			lua_pushnumber(L, v->val.num);
+			lua_pushnumber(L, val.num);
+			break;
+		case SOT_INTEGER:
+			lua_pushinteger(L, val.integer);
+			break;
+		case SOT_BOOLEAN:
+			lua_pushboolean(L, val.boolean);
+			break;
+		case SOT_TABLE:
+			{
+				const char *p = val.str;
+
+				if(!ssvt_decode(L, &p, val.str + len, 0)){
+					selLog->Log('E', "'%s' : corrupted table", vname);
+					lua_pushnil(L);
+				}
+			}
 			break;
 		default :
 			lua_pushnil(L);
 			break;
 		}
-		pthread_mutex_unlock(&v->mutex);
+		ssvc_release(v);
+		return 1;
+	}
+	return 0;
+}
+
+static void ssvl_tonum(lua_State *L, int idx, struct svnum *n){
+/* Lua number (or nil) to svnum */
+	if(lua_type(L, idx) != LUA_TNUMBER){
+		n->type = SOT_UNKNOWN;
+		return;
+	}
+#if LUA_VERSION_NUM > 502
+	if(lua_isinteger(L, idx)){
+		n->type = SOT_INTEGER;
+		n->val.integer = lua_tointeger(L, idx);
+		return;
+	}
+#endif
+	n->type = SOT_NUMBER;
+	n->val.num = lua_tonumber(L, idx);
+}
+
+static void ssvl_pushnum(lua_State *L, const struct svnum *n){
+	if(n->type == SOT_INTEGER)
+		lua_pushinteger(L, n->val.integer);
+	else if(n->type == SOT_NUMBER)
+		lua_pushnumber(L, n->val.num);
+	else
+		lua_pushnil(L);
+}
+
+static int ssvl_atomic(lua_State *L, enum svop op){
+	const char *vname = luaL_checkstring(L, 1);
+	struct svnum arg, expected = { SOT_UNKNOWN };
+	int r;
+
+	if(op == SVO_CAS){
+		if(!lua_isnoneornil(L, 2))
+			luaL_checktype(L, 2, LUA_TNUMBER);
+		luaL_checktype(L, 3, LUA_TNUMBER);
+		ssvl_tonum(L, 2, &expected);
+		ssvl_tonum(L, 3, &arg);
+	} else {
+		luaL_checktype(L, 2, LUA_TNUMBER);
+		ssvl_tonum(L, 2, &arg);
+	}
+
+	if((r = ssvc_atomic(vname, op, &arg, (op == SVO_CAS) ? &expected : NULL)) < 0){
+		lua_pushnil(L);
+		lua_pushfstring(L, "'%s' is not a number", vname);
+		return 2;
+	}
+
+	if(op == SVO_CAS){
+		lua_pushboolean(L, r);
+		ssvl_pushnum(L, &arg);
+		return 2;
+	}
+
+	ssvl_pushnum(L, &arg);
+	if(op == SVO_ADD)
 		return 1;
+	lua_pushboolean(L, r);
+	return 2;
+}
+
+static int ssvl_add(lua_State *L){
+/**
+ * Atomically add a value to a numerical variable (unset variables count as 0)
+ *
+ * @function Add
+ *
+ * @tparam string name the variable's name
+ * @tparam number value to add
+ * @treturn number resulting value (or nil, error if the variable is not a number)
+ * @usage
+local count = SelSharedVar.Add("messages", 1)
+ */
+	return ssvl_atomic(L, SVO_ADD);
+}
+
+static int ssvl_cas(lua_State *L){
+/**
+ * Atomically set a numerical variable if it contains the expected value
+ *
+ * @function CompareAndSet
+ *
+ * @tparam string name the variable's name
+ * @tparam ?number|nil expected value (nil : only if the variable is unset)
+ * @tparam number value new value
+ * @treturn boolean true if the variable has been set
+ * @treturn number variable's value
+ */
+	return ssvl_atomic(L, SVO_CAS);
+}
+
+static int ssvl_min(lua_State *L){
+/**
+ * Atomically lower a numerical variable to value if it's bigger (or unset)
+ *
+ * @function Min
+ *
+ * @tparam string name the variable's name
+ * @tparam number value
+ * @treturn number variable's value
+ * @treturn boolean true if the variable has been updated
+ */
+	return ssvl_atomic(L, SVO_MIN);
+}
+
+static int ssvl_max(lua_State *L){
+/**
+ * Atomically raise a numerical variable to value if it's smaller (or unset)
+ *
+ * @function Max
+ *
+ * @tparam string name the variable's name
+ * @tparam number value
+ * @treturn number variable's value
+ * @treturn boolean true if the variable has been updated
+ */
+	return ssvl_atomic(L, SVO_MAX);
+}
+
+static int ssvl_snapshot(lua_State *L){
+/**
+ * Save all variables to a file (replaced atomically)
+ *
+ * @function Snapshot
+ *
+ * @tparam string file
+ * @treturn boolean false in case of error (logged)
+ * @usage
+SelSharedVar.Snapshot("/var/lib/selene/vars.snap")
+ */
+	lua_pushboolean(L, ssvc_snapshot(luaL_checkstring(L, 1)));
+	return 1;
+}
+
+static int ssvl_restore(lua_State *L){
+/**
+ * Restore variables saved by Snapshot()
+ *
+ * @function Restore
+ *
+ * @tparam string file
+ * @treturn boolean false in case of error (logged)
+ */
+	lua_pushboolean(L, ssvc_restore(luaL_checkstring(L, 1)));
+	return 1;
+}
+
+static int ssvl_autosnapshot(lua_State *L){
+/**
+ * Periodically save all variables in background
+ *
+ * @function AutoSnapshot
+ *
+ * @tparam string file (nil to stop)
+ * @tparam number period in seconds
+ * @treturn boolean false in case of error (logged)
+ * @usage
+SelSharedVar.Restore("/var/lib/selene/vars.snap")
+SelSharedVar.AutoSnapshot("/var/lib/selene/vars.snap", 300)
+ */
+	const char *file = luaL_optstring(L, 1, NULL);
+	lua_Integer period = luaL_optinteger(L, 2, 0);
+
+	if(period < 0)
+		period = 0;
+
+	lua_pushboolean(L, ssvc_autoSnapshot(file, period));
+	return 1;
+}
+
+static int ssvl_watch(lua_State *L){
+/**
+ * Push a task in the todo list when matching variables are set, cleared
+ * or found dead.
+ *
+ * @function Watch
+ *
+ * @tparam string name variable name or pattern (MQTT wildcards '+' and '#' allowed)
+ * @tparam function task to push
+ * @tparam boolean once if true (default), the task is not pushed if already in the todo list
+ * @usage
+SelSharedVar.Watch("sensors/#", refreshDashboard)
+ */
+	const char *pattern = luaL_checkstring(L, 1);
+	enum TaskOnce once = TO_ONCE;
+
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	if(!selScripting){
+		lua_pushnil(L);
+		lua_pushstring(L, "Watch() needs SelScripting");
+		return 2;
+	}
+
+	if(lua_type(L, 3) == LUA_TBOOLEAN)
+		once = lua_toboolean(L, 3) ? TO_ONCE : TO_MULTIPLE;
+	else if(lua_type(L, 3) == LUA_TNUMBER)
+		once = lua_tointeger(L, 3);
+
+	ssvc_addwatcher(pattern, selScripting->findFuncRef(L, 2), once, NULL, NULL);
+
+	return 0;
+}
+
+static int ssvl_unwatch(lua_State *L){
+/**
+ * Remove watchers added by Watch()
+ *
+ * @function Unwatch
+ *
+ * @tparam string name variable name or pattern, as given to Watch()
+ * @tparam function task (optional, all tasks watching this pattern if not provided)
+ */
+	const char *pattern = luaL_checkstring(L, 1);
+	int task = LUA_REFNIL;
+
+	if(lua_type(L, 2) == LUA_TFUNCTION && selScripting)
+		task = selScripting->findFuncRef(L, 2);
+
+	pthread_rwlock_wrlock(&watchers_lock);
+	for(struct watcher **p = &watchers; *p; ){
+		struct watcher *w = *p;
+
+		if(!w->func && !strcmp(w->pattern, pattern) && (task == LUA_REFNIL || task == w->task)){
+			*p = w->next;
+			atomic_fetch_sub(&nwatchers, 1);
+			free(w->pattern);
+			free(w);
+		} else
+			p = &w->next;
 	}
+	pthread_rwlock_unlock(&watchers_lock);
+
 	return 0;
 }
 
 static const struct luaL_Reg SelSharedVarLib [] = {
 	{"dump", ssvl_dump},
 	{"Set", ssvl_set},
+	{"SetInteger", ssvl_setinteger},
 	{"Get", ssvl_get},
+	{"Add", ssvl_add},
+	{"CompareAndSet", ssvl_cas},
+	{"Min", ssvl_min},
+	{"Max", ssvl_max},
+	{"Snapshot", ssvl_snapshot},
+	{"Restore", ssvl_restore},
+	{"AutoSnapshot", ssvl_autosnapshot},
 #if 0
 	{"GetMtime", so_mtime},
 	{"mtime", so_mtime},	/* alias */
@@ -347,6 +2183,25 @@ static const struct luaL_Reg SelSharedVarLib [] = {
 	{NULL, NULL}
 };
 
+static const struct luaL_Reg SelSharedVarMainLib [] = {	/* Main thread only */
+	{"Watch", ssvl_watch},
+	{"Unwatch", ssvl_unwatch},
+	{NULL, NULL}
+};
+
+static bool ssvc_checkdependencies(){	/* Ensure all dependancies are met */
+	return(!!selScripting);
+}
+
+static bool ssvc_laterebuilddependancies(){	/* Add missing dependencies */
+	selScripting = (struct SelScripting *)selCore->findModuleByName("SelScripting", SELSCRIPTING_VERSION, 0);
+	if(!selScripting){	/* We can live w/o it */
+		selLog->Log('D', "SelScripting missing for SelSharedVar");
+	}
+
+	return true;
+}
+
 static void registerSelSharedVar(lua_State *L){
 	selLua->libCreateOrAddFuncs(L, "SelSharedVar", SelSharedVarLib);
 }
@@ -367,25 +2222,55 @@ bool InitModule( void ){
 
 		/* Not mandatory as may be used by C code */
 	selLua =  (struct SelLua *)selCore->findModuleByName("SelLua", SELLUA_VERSION,0);
+	selScripting =  (struct SelScripting *)selCore->findModuleByName("SelScripting", SELSCRIPTING_VERSION,0);
 
 		/* Initialise module's glue */
 	if(!initModule((struct SelModule *)&selSharedVar, "SelSharedVar", SELSHAREDVAR_VERSION, LIBSELENE_VERSION))
 		return false;
 
 	selSharedVar.module.dump = ssvc_dump;
+	selSharedVar.module.checkdependencies = ssvc_checkdependencies;
+	selSharedVar.module.laterebuilddependancies = ssvc_laterebuilddependancies;
 	selSharedVar.clear = ssvc_clear;
 	selSharedVar.setNumber = ssvc_setn;
 	selSharedVar.setString = ssvc_sets;
+	selSharedVar.setStringL = ssvc_setsl;
+	selSharedVar.setInteger = ssvc_seti;
+	selSharedVar.setBoolean = ssvc_setb;
+	selSharedVar.setBlob = ssvc_setblob;
 	selSharedVar.getType = ssvc_getType;
 	selSharedVar.getValue = ssvc_getValue;
+	selSharedVar.getValueL = ssvc_getValueL;
 	selSharedVar.unlockVariable = ssvc_unlockVariable;
 
+	selSharedVar.add = ssvc_add;
+	selSharedVar.addInteger = ssvc_addi;
+	selSharedVar.compareAndSet = ssvc_cas;
+	selSharedVar.compareAndSetInteger = ssvc_casi;
+	selSharedVar.min = ssvc_min;
+	selSharedVar.max = ssvc_max;
+
+	selSharedVar.watch = ssvc_watch;
+	selSharedVar.unwatch = ssvc_unwatch;
+
+	selSharedVar.snapshot = ssvc_snapshot;
+	selSharedVar.restore = ssvc_restore;
+	selSharedVar.autoSnapshot = ssvc_autoSnapshot;
+
 	registerModule((struct SelModule *)&selSharedVar);
 
-	pthread_mutex_init(&mutex_shvar, NULL);
+	ssvs_initcrc();
+
+	pthread_rwlock_init(&vars.lock, NULL);
+	for(unsigned int i = 0; i < SV_STRIPES; i++)
+		pthread_mutex_init(&vars.stripes[i], NULL);
+	assert( (vars.buckets = calloc(SV_MINSIZE, sizeof(struct SharedVar *))) );
+	vars.size = SV_MINSIZE;
+	atomic_init(&vars.count, 0);
 
 	if(selLua){	/* Only if Lua is used */
 		selLua->libCreateOrAddFuncs(NULL, "SelSharedVar", SelSharedVarLib);
+		selLua->libCreateOrAddFuncs(NULL, "SelSharedVar", SelSharedVarMainLib);
 		selLua->AddStartupFunc(registerSelSharedVar);
 	}
 #ifdef DEBUG
@@ -12,17 +12,32 @@
 
 #include <pthread.h>
 #include <time.h>
+#include <stdatomic.h>
+
+struct svstring {	/* String content */
+	struct svstring *next;	/* Retired list */
+	char data[];
+};
 
 struct SharedVar {
 	struct SelObject obj;	/* Object management */
 
 	struct NameH name;	/* Identifier */
-	struct SharedVar *prev, *succ;	/* link list */
+	struct SharedVar *next;	/* hash bucket's chain */
 	enum SharedObjType type;
 	time_t death;	/* when this variable become invalid ? */
+	int heapidx;	/* Position in expiration heap (-1 if none) */
+	bool buried;	/* Dead but still in use : the reaper will try again */
 	time_t mtime;	/* Time of the last modification */
 	union SelSharedVarContent val;
-	pthread_mutex_t mutex;	/*AF* As long their is only 2 threads, a simple mutex is enough */
+	size_t len;		/* SOT_STRING, SOT_BLOB, SOT_TABLE : length of the content (may contain NUL) */
+	pthread_mutex_t mutex;	/* Serialises modifications */
+	bool changed;		/* Watchers have to be notified when unlocked */
+
+		/* Lockless readers */
+	atomic_uint seq;	/* Seqlock : odd while the variable is modified */
+	atomic_uint users;	/* Threads accessing the variable without holding its mutex */
+	_Atomic(struct svstring *) retired;	/* Replaced strings, freed when there is no reader anymore */
 };
 
 #endif
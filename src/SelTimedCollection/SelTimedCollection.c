@@ -9,6 +9,7 @@ Timed values collection.
  *	03/02/2021	LF : storing in userdata prevents sharing b/w thread
  *		so only a pointer in now stored in the state
  *	28/03/2024	LF : Migrate to V7
+ *	18/10/2026	Collections are released when unused
  */
 
 #include <Selene/SelTimedCollection.h>
@@ -102,21 +103,37 @@ static struct SelTimedCollectionStorage *sctc_find(const char *name, unsigned in
 	return((struct SelTimedCollectionStorage *)selCore->findNamedObject((struct SelModule *)&selTimedCollection, name, h));
 }
 
-static int sctl_find(lua_State *L){
-	struct SelTimedCollectionStorage *col = selTimedCollection.find(luaL_checkstring(L, 1), 0);
-	if(!col)
-		return 0;
-
+static void sctl_pushcollection(lua_State *L, struct SelTimedCollectionStorage *col){
+/* Push a Lua object for a collection we hold a reference on
+ * (released by __gc)
+ */
 	struct SelTimedCollectionStorage **r = lua_newuserdata(L, sizeof(struct SelTimedCollectionStorage *));
 	assert(r);
 
 	luaL_getmetatable(L, "SelTimedCollection");
 	lua_setmetatable(L, -2);
 	*r = col;
+}
+
+static int sctl_find(lua_State *L){
+	struct SelTimedCollectionStorage *col = (struct SelTimedCollectionStorage *)selCore->retainNamedObject((struct SelModule *)&selTimedCollection, luaL_checkstring(L, 1), 0);
+	if(!col)
+		return 0;
 
+	sctl_pushcollection(L, col);
 	return 1;
 }
 
+static void sctc_free(struct SelTimedCollectionStorage *col){
+/* Free a collection which is not referenced anymore */
+	pthread_mutex_destroy(&col->mutex);
+	for(size_t i=0; i<col->size; i++)
+		free(col->data[i].data);
+	free(col->data);
+	free((void *)col->obj.id.name);
+	free(col);
+}
+
 static struct SelTimedCollectionStorage *sctc_create(const char *name, size_t size, size_t nbre_data){
 /** 
  * Create a new SelTimedCollection
@@ -159,10 +176,18 @@ static struct SelTimedCollectionStorage *sctc_create(const char *name, size_t si
 	col->full = 0;
 
 		/* Register this collection */
-	if(name)
-		selCore->registerNamedObject((struct SelModule *)&selTimedCollection, (struct _SelNamedObject *)col, strdup(name));
-	else
-		selCore->initObject((struct SelModule *)&selTimedCollection, (struct SelObject *)col);
+	if(name){
+		char *dname = strdup(name);
+		assert(dname);
+		col->obj.id.name = NULL;
+		if(!selCore->registerNamedObject((struct SelModule *)&selTimedCollection, (struct _SelNamedObject *)col, dname)){
+			/* Created meanwhile by another thread : use it */
+			col->obj.id.name = dname;	/* freed with the collection */
+			sctc_free(col);
+			return sctc_find(name, 0);
+		}
+	} else
+		selCore->initNamedObject((struct SelModule *)&selTimedCollection, (struct _SelNamedObject *)col);
 
 
 	MCHECK;
@@ -181,15 +206,41 @@ static int sctl_create(lua_State *L){
 	if((ndata = lua_tointeger( L, 3 )) < 1)
 		ndata = 1;
 	
-	struct SelTimedCollectionStorage **col = (struct SelTimedCollectionStorage **)lua_newuserdata(L, sizeof(struct SelTimedCollectionStorage *));
-	assert(col);
+	struct SelTimedCollectionStorage *col;
+	if(name){
+		while(!(col = (struct SelTimedCollectionStorage *)selCore->retainNamedObject((struct SelModule *)&selTimedCollection, name, 0)))
+			sctc_create(name, size, ndata);	/* (Re)create it as it doesn't exist (anymore) */
+	} else {
+		col = sctc_create(NULL, size, ndata);
+		selCore->retainObject((struct SelModule *)&selTimedCollection, (struct _SelNamedObject *)col);
+	}
 
-	luaL_getmetatable(L, "SelTimedCollection");
-	lua_setmetatable(L, -2);
+	sctl_pushcollection(L, col);
+	return 1;
+}
 
-	*col = sctc_create(name, size, ndata);
+static int sctl_release(lua_State *L){
+/**
+ * Remove the collection from the registry : it can't be found anymore
+ * and is freed as soon as the last reference to it is garbage collected.
+ *
+ * @function Release
+ */
+	struct SelTimedCollectionStorage *col = checkSelTimedCollection(L);
 
-	return 1;
+	if(selCore->unregisterNamedObject((struct SelModule *)&selTimedCollection, (struct _SelNamedObject *)col))
+		sctc_free(col);
+
+	return 0;
+}
+
+static int sctl_gc(lua_State *L){
+	struct SelTimedCollectionStorage *col = checkSelTimedCollection(L);
+
+	if(selCore->releaseNamedObject((struct SelModule *)&selTimedCollection, (struct _SelNamedObject *)col))
+		sctc_free(col);
+
+	return 0;
 }
 
 static void sctc_clear(struct SelTimedCollectionStorage *col){
@@ -693,6 +744,8 @@ static const struct luaL_Reg SelTimedCollectionM [] = {
 	{"GetSize", sctl_getsize},
 	{"Getn", sctl_getn},
 	{"HowMany", sctl_HowMany},
+	{"Release", sctl_release},
+	{"__gc", sctl_gc},
 	{NULL, NULL}
 };
 
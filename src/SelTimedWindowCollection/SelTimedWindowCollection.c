@@ -12,6 +12,7 @@ The current implementation rely on :
  *	10/04/2017	LF : First version
  *	17/03/2021	LF : storing in userdata prevents sharing b/w thread
  *		so only a pointer in now stored in the state
+ *	18/10/2026	Collections are released when unused
  */
 
 #include <Selene/SelTimedWindowCollection.h>
@@ -101,21 +102,35 @@ static struct SelTimedWindowCollectionStorage *stwc_find(const char *name, unsig
 	return((struct SelTimedWindowCollectionStorage *)selCore->findNamedObject((struct SelModule *)&selTimedWindowCollection, name, h));
 }
 
-static int stwl_find(lua_State *L){
-	struct SelTimedWindowCollectionStorage *col = selTimedWindowCollection.find(luaL_checkstring(L, 1), 0);
-	if(!col)
-		return 0;
-
+static void stwl_pushcollection(lua_State *L, struct SelTimedWindowCollectionStorage *col){
+/* Push a Lua object for a collection we hold a reference on
+ * (released by __gc)
+ */
 	struct SelTimedWindowCollectionStorage **r = lua_newuserdata(L, sizeof(struct SelTimedWindowCollectionStorage *));
 	assert(r);
 
 	luaL_getmetatable(L, "SelTimedWindowCollection");
 	lua_setmetatable(L, -2);
 	*r = col;
+}
+
+static int stwl_find(lua_State *L){
+	struct SelTimedWindowCollectionStorage *col = (struct SelTimedWindowCollectionStorage *)selCore->retainNamedObject((struct SelModule *)&selTimedWindowCollection, luaL_checkstring(L, 1), 0);
+	if(!col)
+		return 0;
 
+	stwl_pushcollection(L, col);
 	return 1;
 }
 
+static void stwc_free(struct SelTimedWindowCollectionStorage *col){
+/* Free a collection which is not referenced anymore */
+	pthread_mutex_destroy(&col->mutex);
+	free(col->data);
+	free((void *)col->obj.id.name);
+	free(col);
+}
+
 static struct SelTimedWindowCollectionStorage *stwc_create(const char *name, size_t size, size_t group){
 /** 
  * Create a new SelTimedWindowCollection
@@ -153,10 +168,18 @@ static struct SelTimedWindowCollectionStorage *stwc_create(const char *name, siz
 	col->full = false;
 
 		/* Register this collection */
-	if(name)
-		selCore->registerNamedObject((struct SelModule *)&selTimedWindowCollection, (struct _SelNamedObject *)col, strdup(name));
-	else
-		selCore->initObject((struct SelModule *)&selTimedWindowCollection, (struct SelObject *)col);
+	if(name){
+		char *dname = strdup(name);
+		assert(dname);
+		col->obj.id.name = NULL;
+		if(!selCore->registerNamedObject((struct SelModule *)&selTimedWindowCollection, (struct _SelNamedObject *)col, dname)){
+			/* Created meanwhile by another thread : use it */
+			col->obj.id.name = dname;	/* freed with the collection */
+			stwc_free(col);
+			return stwc_find(name, 0);
+		}
+	} else
+		selCore->initNamedObject((struct SelModule *)&selTimedWindowCollection, (struct _SelNamedObject *)col);
 
 
 	MCHECK;
@@ -175,15 +198,41 @@ static int stwl_create(lua_State *L){
 	if((group = lua_tointeger( L, 3 )) < 1)
 		group = 1;
 	
-	struct SelTimedWindowCollectionStorage **col = (struct SelTimedWindowCollectionStorage **)lua_newuserdata(L, sizeof(struct SelTimedWindowCollectionStorage *));
-	assert(col);
+	struct SelTimedWindowCollectionStorage *col;
+	if(name){
+		while(!(col = (struct SelTimedWindowCollectionStorage *)selCore->retainNamedObject((struct SelModule *)&selTimedWindowCollection, name, 0)))
+			stwc_create(name, size, group);	/* (Re)create it as it doesn't exist (anymore) */
+	} else {
+		col = stwc_create(NULL, size, group);
+		selCore->retainObject((struct SelModule *)&selTimedWindowCollection, (struct _SelNamedObject *)col);
+	}
 
-	luaL_getmetatable(L, "SelTimedWindowCollection");
-	lua_setmetatable(L, -2);
+	stwl_pushcollection(L, col);
+	return 1;
+}
+
+static int stwl_release(lua_State *L){
+/**
+ * Remove the collection from the registry : it can't be found anymore
+ * and is freed as soon as the last reference to it is garbage collected.
+ *
+ * @function Release
+ */
+	struct SelTimedWindowCollectionStorage *col = checkSelTimedWindowCollection(L);
 
-	*col = stwc_create(name, size, group);
+	if(selCore->unregisterNamedObject((struct SelModule *)&selTimedWindowCollection, (struct _SelNamedObject *)col))
+		stwc_free(col);
 
-	return 1;
+	return 0;
+}
+
+static int stwl_gc(lua_State *L){
+	struct SelTimedWindowCollectionStorage *col = checkSelTimedWindowCollection(L);
+
+	if(selCore->releaseNamedObject((struct SelModule *)&selTimedWindowCollection, (struct _SelNamedObject *)col))
+		stwc_free(col);
+
+	return 0;
 }
 
 	/* ***
@@ -694,6 +743,8 @@ static const struct luaL_Reg SelTimedWindowCollectionM [] = {
 	{"Load", stwl_Load},
 	{"Clear", stwl_clear},
 	{"dump", stwl_dump},
+	{"Release", stwl_release},
+	{"__gc", stwl_gc},
 	{NULL, NULL}
 };
 
@@ -32,9 +32,9 @@
 
 struct SelTimer selTimer;
 
-struct SeleneCore *selCore;
-struct SelLog *selLog;
-struct SelLua *selLua;
+static struct SeleneCore *selCore;
+static struct SelLog *selLog;
+static struct SelLua *selLua;
 static struct SelScripting *selScripting;
 
 static struct selTimerStorage *checkSelTimer(lua_State *L){
@@ -102,7 +102,8 @@ static int stl_TimerCreate(lua_State *L){
  * @field clockid clock mode *CLOCK\_REALTIME* (default) or *CLOCK\_MONOTONIC* (see Linux documentation) [@{Create} only]
  * @field ifunc function to run "immediately" when a timer is over
  * @field task function to put in task list
- * @field once avoid task duplication (don't push it again if already in the todo list)
+ * @field once avoid task duplication (don't push it again if already in the todo list) or **Selene.TaskOnceConst()** code
+ * @field priority task's priority (**Selene.TaskPriorityConst()**)
  */
 	struct selTimerStorage *timer;
 	int clockid = CLOCK_REALTIME, t;
@@ -198,6 +199,12 @@ static int stl_TimerCreate(lua_State *L){
 		task_once = lua_tointeger(L, -1);
 	lua_pop(L, 1);	/* Pop the value */
 
+	lua_pushstring(L, "priority");
+	lua_gettable(L, -2);
+	if( lua_type(L, -1) == LUA_TNUMBER )
+		task_once = (task_once & TO_MASK) | (lua_tointeger(L, -1) & TP_MASK);
+	lua_pop(L, 1);	/* Pop the value */
+
 #if 0
 		/* Well, potentially a callbackless timer can be created if the 
 		 * program is polling on Timer:Get() value.
@@ -244,7 +251,7 @@ static int stl_TimerCreate(lua_State *L){
 	if(name)
 		selCore->registerNamedObject((struct SelModule *)&selTimer, (struct _SelNamedObject *)timer, strdup(name));
 	else
-		selCore->initObject((struct SelModule *)&selTimer, (struct SelObject *)timer);
+		selCore->initNamedObject((struct SelModule *)&selTimer, (struct _SelNamedObject *)timer);
 
 
 		/* Create Lua Object */
@@ -273,6 +280,10 @@ static const struct luaL_Reg SelTimerMainLib [] = {
 static int stl_TimerRelease(lua_State *L){
 /** 
  * @brief Release all resources associated with the timer, making it unusable.
+ * A named timer is removed from the registry : its name can be reused.
+ *
+ * Notez-bien : the storage itself is kept as it may still be referenced
+ * by waiting lists.
  *
  * @function Release
  */
@@ -287,6 +298,11 @@ static int stl_TimerRelease(lua_State *L){
 	close(timer->fd);
 	timer->fd = -1;
 
+	if(selCore->unregisterNamedObject((struct SelModule *)&selTimer, (struct _SelNamedObject *)timer)){	/* Was named */
+		free((void *)timer->obj.id.name);
+		timer->obj.id.name = NULL;
+	}
+
 	return 0;
 }
 
@@ -507,7 +523,7 @@ static int stc_getTask(void *r){
 	return (*(struct selTimerStorage **)r)->task;
 }
 
-static bool stc_getOnce(void *r){
+static int stc_getOnce(void *r){
 	return (*(struct selTimerStorage **)r)->once;
 }
 
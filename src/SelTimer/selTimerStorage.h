@@ -12,7 +12,7 @@ struct selTimerStorage {
 	int fd;			/* File descriptor for this timer */
 	int ifunc;		/* Function called "immediately" when timer expires */
 	int task;		/* Function to put in the todo list when the timer expires */
-	bool once;		/* Avoid duplicate in the todo list ? */
+	int once;		/* Avoid duplicate in the todo list ? (TaskOnce + TaskPriority) */
 	bool disable;	/* if set, tasks are not launched */
 
 			/*
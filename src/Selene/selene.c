@@ -1,6 +1,9 @@
 /* Selene : Automation framework using Lua
  *
  * 07/02/2024 LF : redesign for v7
+ * 18/10/2026 Startup's duration traced (SELENE_TRACE_STARTUP)
+ * 18/10/2026 Main script's compilation traced (SELENE_TRACE_STARTUP)
+ * 18/10/2026 Main script loaded through the bytecode cache
  */
 
 #include <Selene/libSelene.h>
@@ -8,6 +11,7 @@
 #include <Selene/SelLog.h>
 #include <Selene/SelLua.h>
 #include <Selene/SelScripting.h>
+#include <Selene/SelElasticStorage.h>
 
 #include <dlfcn.h>		/* dlerror(), ... */
 #include <string.h>
@@ -16,9 +20,9 @@
 #include <libgen.h>		/* dirname(), ... */
 #include <assert.h>
 
-
 int main( int ac, char ** av){
-	
+	uint64_t tstartup = selL_traceBegin();	/* Whole startup's duration */
+
 	/*
 	 * Load mandatory plugins 
 	 */
@@ -77,6 +81,15 @@ int main( int ac, char ** av){
 	if(!SelScripting)
 		exit(EXIT_FAILURE);
 
+	/*
+	 * Optional as well : bytecode cache, only loaded if asked for
+	 */
+	struct SelElasticStorage *SelElasticStorage = getenv("SELENE_BYTECODE_CACHE") ?
+		(struct SelElasticStorage *)SeleneCore->loadModule("SelElasticStorage", SELELASTIC_STORAGE_VERSION, &verfound, 'W') :
+		NULL;
+
+	selL_traceEnd(tstartup, "startup", "Mandatory modules loaded");
+
 #ifdef DEBUG
 	SelLog->Log('D', "Starting script ...");
 #endif
@@ -106,17 +119,29 @@ int main( int ac, char ** av){
 		lua_pushstring(SelLua->getLuaState(), basename(t) );
 		lua_setglobal(SelLua->getLuaState(), "SELENE_SCRIPT_NAME");
 
-		int err = luaL_loadfile(SelLua->getLuaState(), av[1]) || lua_pcall(SelLua->getLuaState(), 0, 0, 0);
+		uint64_t tload = selL_traceBegin();
+		int err = SelElasticStorage ?
+			SelElasticStorage->loadfile(SelLua->getLuaState(), av[1]) :
+			luaL_loadfile(SelLua->getLuaState(), av[1]);
+		selL_traceEnd(tload, "loadScript", av[1]);
+		selL_traceEnd(tstartup, "startup", "Script compiled");
+		selL_traceStop();	/* From now, it's runtime */
+
+		if(!err)
+			err = lua_pcall(SelLua->getLuaState(), 0, 0, 0);
 		if(err){
 			fprintf(stderr, "%s", lua_tostring(SelLua->getLuaState(), -1));
 			lua_pop(SelLua->getLuaState(), 1);  /* pop error message from the stack */
 			exit(EXIT_FAILURE);
 		}
-	} else while(fgets(l, sizeof(l), stdin) != NULL){	/* Interactive mode */
-		int err = luaL_loadbuffer(SelLua->getLuaState(), l, strlen(l), "line") || lua_pcall(SelLua->getLuaState(), 0, 0, 0);
-		if(err){
-			fprintf(stderr, "%s\n", lua_tostring(SelLua->getLuaState(), -1));
-			lua_pop(SelLua->getLuaState(), 1); /* pop error message from the stack */
+	} else {
+		selL_traceStop();
+		while(fgets(l, sizeof(l), stdin) != NULL){	/* Interactive mode */
+			int err = luaL_loadbuffer(SelLua->getLuaState(), l, strlen(l), "line") || lua_pcall(SelLua->getLuaState(), 0, 0, 0);
+			if(err){
+				fprintf(stderr, "%s\n", lua_tostring(SelLua->getLuaState(), -1));
+				lua_pop(SelLua->getLuaState(), 1); /* pop error message from the stack */
+			}
 		}
 	}
 
@@ -160,6 +160,67 @@ static const char *scc_ctime(const time_t *t, char *s, size_t size){
 	return s;
 }
 
+	/* ***
+	 * Named objects
+	 *
+	 * Modules built with libSelene >= 10 index their objects in a hash
+	 * table, older ones are walked linearly.
+	 * nobjmutex has to be held.
+	 * ***/
+
+#define NOBJ_MINSIZE	16	/* Initial number of buckets (power of 2) */
+#define NOBJ_MAXLOAD	2	/* Average chain length triggering a resize */
+
+static struct _SelNamedObject *scc_lookupNamedObject(struct SelModule *mod, const char *name, unsigned int H){
+	if(mod->SelModVersion >= 10){
+		if(!mod->nobjsize)	/* Nothing registered yet */
+			return NULL;
+
+		for(struct _SelNamedObject *obj = mod->nobjbuckets[H & (mod->nobjsize - 1)]; obj; obj = obj->hnext)
+			if((unsigned int)obj->id.H == H && !strcmp(name, obj->id.name))
+				return obj;
+	} else {
+		for(struct _SelNamedObject *obj = mod->objects; obj; obj = obj->next)
+			if((unsigned int)obj->id.H == H && !strcmp(name, obj->id.name))
+				return obj;
+	}
+
+	return NULL;
+}
+
+static void scc_indexNamedObject(struct SelModule *mod, struct _SelNamedObject *obj){
+	if(mod->SelModVersion < 10)
+		return;
+
+	if(mod->nobjcount >= mod->nobjsize * NOBJ_MAXLOAD){	/* (Re)build a bigger index */
+		unsigned int size = mod->nobjsize ? mod->nobjsize * 2 : NOBJ_MINSIZE;
+		struct _SelNamedObject **buckets = calloc(size, sizeof(struct _SelNamedObject *));
+
+		if(buckets){
+			for(unsigned int i = 0; i < mod->nobjsize; i++){
+				struct _SelNamedObject *o, *next;
+				for(o = mod->nobjbuckets[i]; o; o = next){
+					next = o->hnext;
+					o->hnext = buckets[(unsigned int)o->id.H & (size - 1)];
+					buckets[(unsigned int)o->id.H & (size - 1)] = o;
+				}
+			}
+			free(mod->nobjbuckets);
+			mod->nobjbuckets = buckets;
+			mod->nobjsize = size;
+		} else if(!mod->nobjsize){
+			if(selLog)
+				selLog->Log('F', "Can't allocate named objects' index");
+			exit(EXIT_FAILURE);
+		}	/* otherwise, chains are only getting longer */
+	}
+
+	unsigned int idx = (unsigned int)obj->id.H & (mod->nobjsize - 1);
+	obj->hnext = mod->nobjbuckets[idx];
+	mod->nobjbuckets[idx] = obj;
+	mod->nobjcount++;
+}
+
 static bool scc_registerNamedObject(struct SelModule *mod, struct _SelNamedObject *obj, const char *name){
 /**
  * @brief Initialize a module named sub object
@@ -177,16 +238,27 @@ static bool scc_registerNamedObject(struct SelModule *mod, struct _SelNamedObjec
 	}
 
 	unsigned int H = selL_hash(name);
-	struct _SelNamedObject *t = selCore.findNamedObject(mod, name, H);
-	if(t)
+
+	pthread_mutex_lock(&mod->nobjmutex);
+	if(scc_lookupNamedObject(mod, name, H)){
+		pthread_mutex_unlock(&mod->nobjmutex);
 		return false;
+	}
 	
 	selCore.initObject(mod, (struct SelObject *)obj);
-	obj->next = mod->objects;
-	mod->objects = obj;
 	obj->id.name = name;
 	obj->id.H = H;
-	pthread_mutex_init(&mod->nobjmutex, NULL);
+	obj->next = mod->objects;
+	if(mod->SelModVersion >= 11){
+		obj->prev = NULL;
+		if(mod->objects)
+			mod->objects->prev = obj;
+		obj->refs = 1;	/* Registry's one */
+		obj->registered = true;
+	}
+	mod->objects = obj;
+	scc_indexNamedObject(mod, obj);
+	pthread_mutex_unlock(&mod->nobjmutex);
 
 	return true;
 }
@@ -196,15 +268,129 @@ static struct _SelNamedObject *scc_findNamedObject(struct SelModule *mod, const
 		H = selL_hash(name);
 
 	pthread_mutex_lock(&mod->nobjmutex);
-	for(struct _SelNamedObject *obj = mod->objects; obj; obj = obj->next){
-		if(obj->id.H == H && !strcmp(name, obj->id.name)){
-			pthread_mutex_unlock(&mod->nobjmutex);
-			return obj;
+	struct _SelNamedObject *obj = scc_lookupNamedObject(mod, name, H);
+	pthread_mutex_unlock(&mod->nobjmutex);
+
+	return obj;
+}
+
+static void scc_initNamedObject(struct SelModule *mod, struct _SelNamedObject *obj){
+/**
+ * @brief Initialize an unnamed object which life cycle is managed
+ * by references (see retainObject())
+ *
+ * @function initNamedObject
+ */
+	selCore.initObject(mod, (struct SelObject *)obj);
+	obj->next = NULL;
+	obj->id.name = NULL;
+	obj->id.H = 0;
+	if(mod->SelModVersion >= 11){
+		obj->prev = NULL;
+		obj->refs = 0;
+		obj->registered = false;
+	}
+}
+
+static struct _SelNamedObject *scc_retainNamedObject(struct SelModule *mod, const char *name, unsigned int H){
+/**
+ * @brief Find an object and take a reference on it
+ *
+ * @function retainNamedObject
+ * @return NULL if not found
+ */
+	if(!H)
+		H = selL_hash(name);
+
+	pthread_mutex_lock(&mod->nobjmutex);
+	struct _SelNamedObject *obj = scc_lookupNamedObject(mod, name, H);
+	if(obj && mod->SelModVersion >= 11)
+		obj->refs++;
+	pthread_mutex_unlock(&mod->nobjmutex);
+
+	return obj;
+}
+
+static void scc_retainObject(struct SelModule *mod, struct _SelNamedObject *obj){
+/**
+ * @brief Take another reference on an object we already hold
+ * (or on an unnamed object)
+ *
+ * @function retainObject
+ */
+	if(mod->SelModVersion < 11)
+		return;
+
+	pthread_mutex_lock(&mod->nobjmutex);
+	obj->refs++;
+	pthread_mutex_unlock(&mod->nobjmutex);
+}
+
+static void scc_unlinkNamedObject(struct SelModule *mod, struct _SelNamedObject *obj){
+/* Remove an object from the registry
+ * -> nobjmutex has to be held
+ */
+	struct _SelNamedObject **p = &mod->nobjbuckets[(unsigned int)obj->id.H & (mod->nobjsize - 1)];
+	for(; *p; p = &(*p)->hnext)
+		if(*p == obj){
+			*p = obj->hnext;
+			break;
 		}
+	mod->nobjcount--;
+
+	if(obj->prev)
+		obj->prev->next = obj->next;
+	else
+		mod->objects = obj->next;
+	if(obj->next)
+		obj->next->prev = obj->prev;
+
+	obj->registered = false;
+}
+
+static bool scc_releaseNamedObject(struct SelModule *mod, struct _SelNamedObject *obj){
+/**
+ * @brief Drop a reference
+ *
+ * @function releaseNamedObject
+ * @return true if it was the last one : the object has to be freed
+ */
+	bool last;
+
+	if(mod->SelModVersion < 11)
+		return false;
+
+	pthread_mutex_lock(&mod->nobjmutex);
+	if(obj->refs)
+		obj->refs--;
+	last = !obj->refs && !obj->registered;
+	pthread_mutex_unlock(&mod->nobjmutex);
+
+	return last;
+}
+
+static bool scc_unregisterNamedObject(struct SelModule *mod, struct _SelNamedObject *obj){
+/**
+ * @brief Remove an object from the registry : it can't be found anymore
+ * and its name may be reused.
+ * The registry's reference is dropped.
+ *
+ * @function unregisterNamedObject
+ * @return true if it was the last reference : the object has to be freed
+ */
+	bool last = false;
+
+	if(mod->SelModVersion < 11)
+		return false;
+
+	pthread_mutex_lock(&mod->nobjmutex);
+	if(obj->registered){
+		scc_unlinkNamedObject(mod, obj);
+		last = !--obj->refs;
 	}
 	pthread_mutex_unlock(&mod->nobjmutex);
 
-	return NULL;
+	return last;
 }
 
 static void scc_lockObjList(struct SelModule *mod){
@@ -294,6 +480,11 @@ bool InitModule( void ){
 	selCore.unlockObjList = scc_unlockObjList;
 	selCore.getFirstNamedObject = scc_getFirstNamedObject;
 	selCore.getNextNamedObject = scc_getNextNamedObject;
+	selCore.initNamedObject = scc_initNamedObject;
+	selCore.retainNamedObject = scc_retainNamedObject;
+	selCore.retainObject = scc_retainObject;
+	selCore.releaseNamedObject = scc_releaseNamedObject;
+	selCore.unregisterNamedObject = scc_unregisterNamedObject;
 
 	selCore.initObject = scc_initObject;
 	selCore.initGenericSurface = scc_initGenericSurface;
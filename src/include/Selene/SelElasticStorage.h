@@ -11,7 +11,7 @@
 /* *********** 
  * /!\ CAUTION : BUMP THIS VERSION AT EVERY CHANGE INSIDE GLUE STRUCTURE
  * ***********/
-#define SELELASTIC_STORAGE_VERSION 3
+#define SELELASTIC_STORAGE_VERSION 5
 
 #ifdef __cplusplus
 extern "C"
@@ -31,6 +31,7 @@ struct elastic_storage {
 */
 	size_t storage_sz;
 	size_t data_sz;
+	unsigned int generation;	/* Unique among all storages, changes with the content */
 	pthread_mutex_t mutex;
 };
 
@@ -55,6 +56,9 @@ struct SelElasticStorage {
 		/* Low level shared function handling */
 	int (*dumpwriter)(lua_State *L, const void *b, size_t size, void *s);
 	int (*loadsharedfunction)(lua_State *L, struct elastic_storage *func);
+
+		/* luaL_loadfile() using the bytecode cache if SELENE_BYTECODE_CACHE is set */
+	int (*loadfile)(lua_State *L, const char *path);
 };
 
 #ifdef __cplusplus
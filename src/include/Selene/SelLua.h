@@ -15,7 +15,7 @@
 /* *********** 
  * /!\ CAUTION : BUMP THIS VERSION AT EVERY CHANGE INSIDE GLUE STRUCTURE
  * ***********/
-#define SELLUA_VERSION 11 
+#define SELLUA_VERSION 12 
 
 #include <lua.h>
 #include <lauxlib.h>	/* auxlib : usable hi-level function */
@@ -27,11 +27,7 @@ extern "C"
 #endif
 
 #ifndef TASKSSTACK_LEN
-#	define TASKSSTACK_LEN 256	/* Maximum number pending tasks */
-#endif
-
-#ifndef WAITMAXFD
-#	define WAITMAXFD	256		/* Maximum number of FD to wait for */
+#	define TASKSSTACK_LEN 256	/* Default high-water mark of pending tasks */
 #endif
 
 
@@ -43,6 +39,15 @@ enum TaskOnce {
 	TO_LAST				/* Only one run but put at the end of the queue */
 };
 
+enum TaskPriority {	/* To be combined with TaskOnce */
+	TP_NORMAL = 0,
+	TP_CRITICAL = 4,	/* Run before any other task */
+	TP_BACKGROUND = 8	/* Run when nothing else is waiting */
+};
+
+#define TO_MASK 0x03	/* TaskOnce part of "once" */
+#define TP_MASK 0x0c	/* TaskPriority part of "once" */
+
 struct SelLua {
 	struct SelModule module;
 
@@ -63,6 +68,7 @@ struct SelLua {
 
 	void (*AddStartupFunc)(void (*)(lua_State *));
 	void (*ApplyStartupFunc)(lua_State *);
+	unsigned int (*getStartupGeneration)(void);
 
 	void (*lateBuildingDependancies)(lua_State *);
 };
@@ -11,7 +11,7 @@
 /* *********** 
  * /!\ CAUTION : BUMP THIS VERSION AT EVERY CHANGE INSIDE GLUE STRUCTURE
  * ***********/
-#define SELMQTT_VERSION 3
+#define SELMQTT_VERSION 7
 
 #include <Selene/SelLua.h>
 
@@ -31,19 +31,32 @@ struct enhanced_client {
 
 	MQTTClient client;	/* Paho's client handle */
 	struct _topic *subscriptions;	/* Linked list of subscription */
+	struct topicnode *trie;		/* Subscriptions index */
 	struct elastic_storage *onDisconnectFunc;	/* Function called in case of disconnection with the broker */
 	int onDisconnectTrig;	/* Triggercalled in case of disconnection with the broker */
 };
 
+struct SelMQTTMessage {	/* Message to be published by mqttpublishv() */
+	const char *topic;
+	const void *payload;
+	int length;
+	int qos;
+	int retained;
+};
+
 struct SelMQTT {
 	struct SelModule module;
 
 		/* Call backs */
 	int (*mqttpublish)(MQTTClient, const char *topic, int length, void *payload, int retained);
+	int (*mqttpublishv)(MQTTClient, const struct SelMQTTMessage *msgs, unsigned int nbre, int trigger, enum TaskOnce trigger_once);
+	bool (*configurePublisher)(unsigned int queue, unsigned int window);
+	bool (*coalescePublish)(const char *filter, unsigned long int window, bool onlychanged);
 	int (*mqtttokcmp)(const char *s, const char *t);
 	struct enhanced_client *(*checkSelMQTT)(lua_State *);
 
 	void (*createExternallyManaged)(lua_State *, MQTTClient);
+	const void *(*getPayload)(lua_State *, int idx, size_t *len);	/* SelMQTTPayload's content */
 };
 
 #ifdef __cplusplus
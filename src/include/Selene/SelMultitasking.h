@@ -13,7 +13,7 @@
 /* *********** 
  * /!\ CAUTION : BUMP THIS VERSION AT EVERY CHANGE INSIDE GLUE STRUCTURE
  * ***********/
-#define SELMULTITASKING_VERSION 1
+#define SELMULTITASKING_VERSION 3
 
 #ifdef __cplusplus
 extern "C"
@@ -28,6 +28,9 @@ struct SelMultitasking {
 	bool (*loadandlaunch)( lua_State *L, lua_State *newL, struct elastic_storage *storage, int nargs, int nresults, int trigger, enum TaskOnce trigger_once);
 	bool (*newthreadfunc)(lua_State *, struct elastic_storage *);
 	int (*dumpwriter)(lua_State *, const void *, size_t, void *); /* need selElasticStorage */
+	bool (*configureWorkers)(unsigned int min, unsigned int max, unsigned int queue, unsigned int idle);
+	void (*releaseSlaveState)(lua_State *);
+	void (*configureStatesPool)(unsigned int max, unsigned int uses, unsigned int age);
 };
 
 #ifdef __cplusplus
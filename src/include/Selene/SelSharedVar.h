@@ -12,7 +12,7 @@
 /* *********** 
  * /!\ CAUTION : BUMP THIS VERSION AT EVERY CHANGE INSIDE GLUE STRUCTURE
  * ***********/
-#define SELSHAREDVAR_VERSION 1
+#define SELSHAREDVAR_VERSION 6
 
 	/* ***
 	 * Shared variables
@@ -22,12 +22,37 @@ enum SharedObjType {
 	SOT_UNKNOWN = 0,	/* Invalid variable */
 	SOT_NUMBER,		/* Integers */
 	SOT_STRING,		/* Dynamically allocated string (managed by sharedobj' functions) */
-	SOT_XSTRING		/* Const char * managed externally (constant, allocated elsewhere ...) */
+	SOT_XSTRING,	/* Const char * managed externally (constant, allocated elsewhere ...) */
+	SOT_INTEGER,	/* 64 bits integer */
+	SOT_BOOLEAN,
+	SOT_BLOB,		/* Binary data of a given length (managed by sharedobj' functions) */
+	SOT_TABLE		/* Serialised Lua table (see SharedTableTag) */
 };
 
 union SelSharedVarContent {
 	double num;
-	const char *str;
+	const char *str;	/* strings, blobs and tables */
+	int64_t integer;
+	bool boolean;
+};
+
+/* SOT_TABLE's flat encoding
+ *
+ * The content is a single SVT_TABLE item. Each item is a one byte tag
+ * followed by its payload, in host byte order :
+ *	SVT_NUMBER	double
+ *	SVT_INTEGER	int64_t
+ *	SVT_BOOLEAN	one byte (0 or 1)
+ *	SVT_STRING	uint32_t length followed by the bytes (not NUL terminated)
+ *	SVT_TABLE	key/value item pairs, up to SVT_END
+ */
+enum SharedTableTag {
+	SVT_END = 0,
+	SVT_NUMBER,
+	SVT_INTEGER,
+	SVT_BOOLEAN,
+	SVT_STRING,
+	SVT_TABLE
 };
 
 struct SelSharedVar {
@@ -37,10 +62,32 @@ struct SelSharedVar {
 	void (*clear)(const char *);
 	void (*setNumber)(const char *, double, unsigned long int);
 	void (*setString)(const char *, const char *, unsigned long int);
+	void (*setStringL)(const char *, const char *, size_t, unsigned long int);
+	void (*setInteger)(const char *, int64_t, unsigned long int);
+	void (*setBoolean)(const char *, bool, unsigned long int);
+	void (*setBlob)(const char *, const void *, size_t, unsigned long int);
 
 	enum SharedObjType (*getType)(const char *);
 	union SelSharedVarContent (*getValue)(const char *, enum SharedObjType *, bool);
+	union SelSharedVarContent (*getValueL)(const char *, enum SharedObjType *, size_t *, bool);
 	void (*unlockVariable)(const char *);
+
+		/* Atomic operations on numerical variables (unset ones are created) */
+	bool (*add)(const char *, double, double *);
+	bool (*addInteger)(const char *, int64_t, int64_t *);
+	bool (*compareAndSet)(const char *, double expected, double);
+	bool (*compareAndSetInteger)(const char *, int64_t expected, int64_t);
+	bool (*min)(const char *, double, double *);
+	bool (*max)(const char *, double, double *);
+
+		/* Change notification */
+	void *(*watch)(const char *pattern, void (*func)(const char *name, void *data), void *data);
+	void (*unwatch)(void *handle);
+
+		/* Persistence */
+	bool (*snapshot)(const char *file);
+	bool (*restore)(const char *file);
+	bool (*autoSnapshot)(const char *file, unsigned long int period);
 };
 
 #endif
@@ -11,7 +11,7 @@
 /* *********** 
  * /!\ CAUTION : BUMP THIS VERSION AT EVERY CHANGE INSIDE GLUE STRUCTURE
  * ***********/
-#define SELTIMER_VERSION 2
+#define SELTIMER_VERSION 3
 
 #ifdef __cplusplus
 extern "C"
@@ -28,7 +28,7 @@ struct SelTimer {
 	int (*getFD)(void *);
 	int (*getiFunc)(void *);
 	int (*getTask)(void *);
-	bool (*getOnce)(void *);
+	int (*getOnce)(void *);
 	bool (*isDisabled)(void *);
 	struct selTimerStorage *(*find)(const char *, unsigned int);
 };
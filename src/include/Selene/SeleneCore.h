@@ -7,6 +7,7 @@
  *	History :
  *	---------
  *	v8	- Add lock/unlock in SelGenericSurface
+ *	v9	- Named objects' life cycle (reference counting and unregistration)
  */
 
 #ifndef SELENECORE_VERSION
@@ -15,7 +16,7 @@
 /* *********** 
  * /!\ CAUTION : BUMP THIS VERSION AT EVERY CHANGE INSIDE GLUE STRUCTURE
  * ***********/
-#define SELENECORE_VERSION 8
+#define SELENECORE_VERSION 9
 
 #include "Selene/SelLog.h"
 
@@ -64,6 +65,16 @@ struct SeleneCore {
 	void (*initObject)(struct SelModule *, struct SelObject *);
 	void (*initGenericSurface)(struct SelModule *, struct SelGenericSurface *);
 	void (*initGenericSurfaceCallBacks)(struct SGS_callbacks *);
+
+		/* Named objects' life cycle
+		 * Objects are freed by their module when the last reference
+		 * is released.
+		 */
+	void (*initNamedObject)(struct SelModule *, struct _SelNamedObject *);	/* Unnamed object without reference */
+	struct _SelNamedObject *(*retainNamedObject)(struct SelModule *, const char *, unsigned int);
+	void (*retainObject)(struct SelModule *, struct _SelNamedObject *);
+	bool (*releaseNamedObject)(struct SelModule *, struct _SelNamedObject *);
+	bool (*unregisterNamedObject)(struct SelModule *, struct _SelNamedObject *);
 };
 
 #ifdef __cplusplus
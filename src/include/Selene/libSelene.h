@@ -18,7 +18,7 @@
 /* *********** 
  * /!\ CAUTION : BUMP THIS VERSION AT EVERY CHANGE INSIDE GLUE STRUCTURE
  * ***********/
-#define LIBSELENE_VERSION 9
+#define LIBSELENE_VERSION 11
 
 #ifdef __cplusplus
 extern "C"
@@ -55,8 +55,15 @@ struct NameH {
 struct _SelNamedObject {
 	struct SelObject object;
 
-	struct _SelNamedObject *next;
+	struct _SelNamedObject *next;	/* All module's objects */
 	struct NameH id;
+
+	struct _SelNamedObject *hnext;	/* Hash bucket's chain (libSelene >= 10) */
+
+		/* Life cycle (libSelene >= 11), protected by module's nobjmutex */
+	struct _SelNamedObject *prev;	/* in module's objects list */
+	unsigned int refs;	/* References (the registry holds one while registered) */
+	bool registered;	/* Still findable by its name */
 };
 
 
@@ -91,6 +98,11 @@ struct SelModule {
 	void (*exposeAdminAPI)(void *); /* Request to expose administration API. Real arg is lua_State * */
 
 	uint64_t (*getCapabilities)();		/* Returns all capabilities */
+
+		/* Named objects' index (libSelene >= 10), protected by nobjmutex */
+	struct _SelNamedObject **nobjbuckets;
+	unsigned int nobjsize;		/* Number of buckets (power of 2, 0 if not allocated yet) */
+	unsigned int nobjcount;		/* Number of named objects */
 };
 
 	/* list of loaded modules */
@@ -107,6 +119,11 @@ extern bool registerModule(struct SelModule *);
 
 	/* Capabilities */
 extern bool checkCapabilities(struct SelObject *, uint64_t);
+
+	/* Startup's tracing (active if SELENE_TRACE_STARTUP is set) */
+extern uint64_t selL_traceBegin(void);
+extern void selL_traceEnd(uint64_t begin, const char *cat, const char *name);
+extern void selL_traceStop(void);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,30 @@
+/* bundle.h
+ *
+ * Modules linked inside Selene's executable when built with STATIC_BUNDLE.
+ *
+ * Each line is BUNDLE(<module name>) : its InitModule() is renamed
+ * <module name>_InitModule() at compilation time.
+ * This file is parsed as well by remake.sh to know which modules to link :
+ * keep one module per line.
+ *
+ * 18/10/2026 First version
+ */
+
+BUNDLE(SeleneCore)
+BUNDLE(SelLog)
+BUNDLE(SelLua)
+BUNDLE(SelScripting)
+BUNDLE(SelElasticStorage)
+BUNDLE(SelMultitasking)
+BUNDLE(SelSharedFunction)
+BUNDLE(SelSharedRef)
+BUNDLE(SelSharedVar)
+BUNDLE(SelMQTT)
+BUNDLE(SelError)
+BUNDLE(SelTimer)
+BUNDLE(SelFIFO)
+BUNDLE(SelEvent)
+BUNDLE(SelCollection)
+BUNDLE(SelAverageCollection)
+BUNDLE(SelTimedCollection)
+BUNDLE(SelTimedWindowCollection)
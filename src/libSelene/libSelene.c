@@ -1,6 +1,8 @@
 /* libSelene.h
  *
  * 04/01/2024 First version
+ * 18/10/2026 Modules prelinked within the executable (STATIC_BUNDLE)
+ * 18/10/2026 Modules loading traced
  */
 
 #include <Selene/libSelene.h>
@@ -12,18 +14,80 @@
 
 struct SelModule *modules = NULL;
 
+#ifdef STATIC_BUNDLE
+	/* Modules linked inside the executable.
+	 * Their InitModule() is renamed <module>_InitModule() by remake.sh
+	 */
+#define BUNDLE(x) extern bool x##_InitModule(void);
+#include "bundle.h"
+#undef BUNDLE
+
+static const struct {
+	const char *name;
+	bool (*init)(void);
+} bundled[] = {
+#define BUNDLE(x) { #x, x##_InitModule },
+#include "bundle.h"
+#undef BUNDLE
+	{ NULL, NULL }
+};
+
+/**
+ * @brief Search for a module linked inside the executable
+ *
+ * @function findBundledModule
+ * @param name Name of the module we are looking for
+ * @return its initialisation function or NULL if not bundled
+ */
+static bool (*findBundledModule(const char *name))(void){
+	for(int i = 0; bundled[i].name; i++)
+		if(!strcmp(name, bundled[i].name))
+			return bundled[i].init;
+
+	return NULL;
+}
+#endif
+
 /**
- * Calculate the hash code of the given string
+ * Calculate the hash code of the given string (32 bits FNV-1a)
  *
  * @function selL_hash
  * @param s string to calculate the hash code
  * @return hashcode
  */
 unsigned int selL_hash(const char *s){
-	unsigned int r = 0;
-	for(; *s; s++)
-		r += *s;
-	return r;	
+	uint32_t r = 2166136261u;	/* FNV offset basis */
+	for(; *s; s++){
+		r ^= (unsigned char)*s;
+		r *= 16777619u;		/* FNV prime */
+	}
+	return r;
+}
+
+/**
+ * @brief Load a module's shared object from disk
+ *
+ * @function findPluginModule
+ * @param name Name of the module to load
+ * @return its initialisation function or NULL if not found
+ */
+static bool (*findPluginModule(const char *name))(void){
+	char t[strlen(PLUGIN_DIR) + strlen(name) + 12];	/* "/Selene/.so" */
+	sprintf(t, "%s/Selene/%s.so", PLUGIN_DIR, name);
+
+	void *pgh = dlopen(t, RTLD_LAZY);
+	if(!pgh)
+		return NULL;	/* .so not found */
+	dlerror(); /* Clear any existing error */
+
+		/* execute, initialisation function */
+	bool (*func)(void);
+	if(!(func = dlsym( pgh, "InitModule" ))){
+		fputs("*F* Can't find InitModule()\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	return func;
 }
 
 /**
@@ -49,27 +113,25 @@ struct SelModule *loadModule(const char *name, uint16_t minversion, uint16_t *fo
 			return NULL;	/* obsolete version loaded */
 	}
 
-		/* Load from disk */
-	char t[strlen(PLUGIN_DIR) + strlen(name) + 12];	/* "/Selene/.so" */
-	sprintf(t, "%s/Selene/%s.so", PLUGIN_DIR, name);
-
-	void *pgh = dlopen(t, RTLD_LAZY);
-	if(!pgh)
+	uint64_t tload = selL_traceBegin();
+	bool (*func)(void) = NULL;
+#ifdef STATIC_BUNDLE
+	func = findBundledModule(name);
+#endif
+	if(!func && !(func = findPluginModule(name))){
+		selL_traceEnd(tload, "loadModule", name);
 		return NULL;	/* .so not found */
-	dlerror(); /* Clear any existing error */
-
-		/* execute, initialisation function */
-	bool (*func)(void);
-	if(!(func = dlsym( pgh, "InitModule" ))){
-		fputs("*F* Can't find InitModule()\n", stderr);
-		exit(EXIT_FAILURE);
 	}
 
 		/* Execute it.
 		 * It has to register the newly loaded module. Consequently, it is the
 		 * 1st of modules' list.
 		 */
-	if(!(*func)())
+	uint64_t tinit = selL_traceBegin();
+	bool ok = (*func)();
+	selL_traceEnd(tinit, "InitModule", name);
+	selL_traceEnd(tload, "loadModule", name);
+	if(!ok)
 		return NULL;
 
 	*found = modules->version;
@@ -136,6 +198,7 @@ bool initModule(struct SelModule *module, const char *name, uint16_t version, ui
 	module->found = false;
 
 	module->objects = NULL;
+	pthread_mutex_init(&module->nobjmutex, NULL);
 
 	module->initLua = NULL;
 	module->checkdependencies = truebydefault;	/* by default, all dependencies are met */
@@ -153,6 +216,12 @@ bool initModule(struct SelModule *module, const char *name, uint16_t version, ui
 			module->getCapabilities = zerobydefault;
 	}
 
+	if(libSelene_version >= 10){
+		module->nobjbuckets = NULL;
+		module->nobjsize = 0;
+		module->nobjcount = 0;
+	}
+
 	return true;
 }
 
@@ -0,0 +1,131 @@
+/* trace.c
+ *
+ * Startup's timeline, written in Chrome's trace-event format
+ * (to be opened with chrome://tracing or Perfetto).
+ *
+ * Activated by SELENE_TRACE_STARTUP environment variable which contains
+ * the file to write to.
+ * Events are written as soon as they are completed : the JSON array format
+ * doesn't require the closing bracket, so the trace stays usable even if
+ * Selene is killed.
+ * Tracing stops when the main script starts (selL_traceStop()) : what
+ * follows is runtime, not startup.
+ *
+ * 18/10/2026 First version
+ * 18/10/2026 Stopped when the main script starts
+ */
+
+#include <Selene/libSelene.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>	/* SYS_gettid */
+
+static pthread_once_t traceonce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t tracemutex = PTHREAD_MUTEX_INITIALIZER;
+static FILE *tracefile = NULL;
+static bool tracefirst = true;	/* No event written yet */
+static atomic_bool tracing;		/* Trace file opened and not yet stopped */
+
+static uint64_t selL_tracenow(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void selL_traceclose(void){
+	atomic_store(&tracing, false);
+
+	pthread_mutex_lock(&tracemutex);
+	if(tracefile){
+		fputs("\n]\n", tracefile);
+		fclose(tracefile);
+		tracefile = NULL;
+	}
+	pthread_mutex_unlock(&tracemutex);
+}
+
+static void selL_traceinit(void){
+	const char *fn = getenv("SELENE_TRACE_STARTUP");
+	if(!fn || !*fn)
+		return;
+
+	if(!(tracefile = fopen(fn, "w"))){
+		fprintf(stderr, "*E* Can't create trace file '%s' : %s\n", fn, strerror(errno));
+		return;
+	}
+
+	fputc('[', tracefile);
+	atexit(selL_traceclose);
+	atomic_store(&tracing, true);
+}
+
+static void selL_tracestr(const char *s){
+	for(; *s; s++){
+		if(*s == '"' || *s == '\\')
+			fputc('\\', tracefile);
+		if((unsigned char)*s < ' ')
+			fprintf(tracefile, "\\u%04x", *s);
+		else
+			fputc(*s, tracefile);
+	}
+}
+
+/**
+ * @brief Start to measure a traced step
+ *
+ * @function selL_traceBegin
+ * @return step's starting time or 0 if tracing is disabled
+ */
+uint64_t selL_traceBegin(void){
+	pthread_once(&traceonce, selL_traceinit);
+
+	return atomic_load(&tracing) ? selL_tracenow() : 0;
+}
+
+/**
+ * @brief End of the startup : close the trace
+ *
+ * Following selL_traceBegin() return 0, so steps done at runtime
+ * (like slave threads' startup functions) are not traced anymore.
+ *
+ * @function selL_traceStop
+ */
+void selL_traceStop(void){
+	pthread_once(&traceonce, selL_traceinit);
+	selL_traceclose();
+}
+
+/**
+ * @brief Record a completed step in the trace
+ *
+ * @function selL_traceEnd
+ * @param begin value returned by selL_traceBegin()
+ * @param cat category of the step (loadModule, initLua, ...)
+ * @param name name of the step (typically, the module's)
+ */
+void selL_traceEnd(uint64_t begin, const char *cat, const char *name){
+	if(!begin)	/* Tracing disabled */
+		return;
+
+	uint64_t now = selL_tracenow();
+
+	pthread_mutex_lock(&tracemutex);
+	if(tracefile){
+		fprintf(tracefile, "%s\n{\"name\":\"", tracefirst ? "" : ",");
+		selL_tracestr(name);
+		fprintf(tracefile, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%ld}",
+			cat, (unsigned long long)begin, (unsigned long long)(now - begin),
+			(int)getpid(), (long)syscall(SYS_gettid)
+		);
+		fflush(tracefile);
+		tracefirst = false;
+	}
+	pthread_mutex_unlock(&tracemutex);
+}